@@ -0,0 +1,856 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <errno.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+#include "block.h"
+#include "world.h"
+#include "simulate.h"
+#include "snapshot.h"
+#include "replay.h"
+#include "profiler.h"
+#include "region.h"
+#include "capture.h"
+
+typedef struct Scenario_
+{
+    char *name;
+    void (*setup)(World *w);
+    void (*step)(World *w, int tick);
+} Scenario;
+
+double get_secs(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + (1e-9 * ts.tv_nsec);
+}
+
+void setupSandPile(World *w)
+{
+    fillRect(w, SAND, w->width / 4, w->height / 2, w->width * 3 / 4, w->height, 1);
+}
+
+void stepSandPile(World *w, int tick)
+{
+    Color c;
+    getBlockColor(SAND, &c);
+    if (tick % 2 == 0)
+        for (int x = w->width / 2 - 2; x <= w->width / 2 + 2; ++x)
+            addBlock(w, SAND, x, w->height - 1, 1, c);
+}
+
+void setupWaterTank(World *w)
+{
+    int left = w->width / 8, right = w->width * 7 / 8;
+    fillRect(w, CONCRETE, left, 0, left + 2, w->height / 2, 0);
+    fillRect(w, CONCRETE, right - 2, 0, right, w->height / 2, 0);
+    fillRect(w, WATER, left + 2, 0, (left + right) / 2, w->height * 3 / 4, 1);
+}
+
+void stepRainStorm(World *w, int tick)
+{
+    (void) tick;
+    for (int i = 0; i < w->width / 32 + 1; ++i) rain(w);
+}
+
+void setupMixed(World *w)
+{
+    // A few static ledges with gaps for things to pour through
+    for (int i = 1; i <= 3; ++i)
+    {
+        int y = w->height * i / 5;
+        fillRect(w, CONCRETE, w->width / 10, y, w->width * 4 / 10, y + 2, 0);
+        fillRect(w, CONCRETE, w->width * 6 / 10, y, w->width * 9 / 10, y + 2, 0);
+    }
+    fillRect(w, SAND, w->width / 8, w->height * 4 / 5 + 2, w->width * 3 / 8, w->height, 1);
+    fillRect(w, WATER, w->width * 5 / 8, w->height * 4 / 5 + 2, w->width * 7 / 8, w->height, 1);
+}
+
+void stepMixed(World *w, int tick)
+{
+    stepSandPile(w, tick);
+    rain(w);
+}
+
+void setupLayers(World *w)
+{
+    // Oil ends up floating on the water, the gravel sinks to the bottom and the smoke bubbles up
+    fillRect(w, WATER, w->width / 4, 0, w->width * 3 / 4, w->height / 4, 1);
+    fillRect(w, SMOKE, w->width * 3 / 8, 0, w->width * 5 / 8, w->height / 16, 1);
+    fillRect(w, OIL, w->width / 4, w->height / 2, w->width * 3 / 4, w->height * 5 / 8, 1);
+    fillRect(w, GRAVEL, w->width * 3 / 8, w->height * 3 / 4, w->width * 5 / 8, w->height * 7 / 8, 1);
+}
+
+Scenario snapshotScenario = {"snapshot", NULL, NULL};
+
+Scenario scenarios[] = {
+        {"sand",  setupSandPile,  stepSandPile},
+        {"water", setupWaterTank, NULL},
+        {"rain",  NULL,           stepRainStorm},
+        {"mixed", setupMixed,     stepMixed},
+        {"layers", setupLayers,   NULL},
+};
+
+#define SCENARIO_COUNT ((int) (sizeof(scenarios) / sizeof(scenarios[0])))
+
+int sleepChunks = 1;
+char *loadPath = NULL;
+char *savePrefix = NULL;
+char *replayPath = NULL;
+int pageAfter = 0;
+char *pagePath = NULL;
+char *profilePrefix = NULL;
+int dispersion = 1;
+int fallSpeed = 1;
+int untilSettled = 0;
+int compareEngines = 0;
+int checkCounts = 0;
+// Runs whose column or material counts did not match the cells
+int badCounts = 0;
+// Checksum of the world the last run ended with
+uint32_t lastChecksum = 0;
+char *capturePrefix = NULL;
+int captureEvery = 1;
+CaptureFormat captureFormat = CAPTURE_Y4M;
+Engine engine = ENGINE_CELLS;
+char *batchPath = NULL;
+char *outDir = ".";
+
+// One world of a batch, the settings come from a line of the job file and whatever it leaves out from
+// the command line
+typedef struct Job_
+{
+    char name[64];
+    Scenario *scenario;
+    char *loadPath;
+    int width;
+    int height;
+    int ticks;
+    uint64_t seed;
+    Engine engine;
+    int dispersion;
+    int fallSpeed;
+    // Extra calls to rain per tick on top of what the scenario does
+    int rain;
+    int untilSettled;
+    // Results
+    int ran;
+    // First tick after which the world was settled, 0 when it never was
+    uint64_t settledAt;
+    double seconds;
+    WorldStats stats;
+    uint32_t checksum;
+    int saved;
+} Job;
+
+typedef struct Batch_
+{
+    Job *jobs;
+    // Job indices by expected cost, the most expensive first
+    int *order;
+    int count;
+} Batch;
+
+uint32_t worldChecksum(World *w)
+{
+    uint32_t hash = 2166136261u;
+    for (int y = 0; y < w->height; ++y)
+        for (int x = 0; x < w->width; ++x)
+        {
+            hash ^= getBlockType(w, x, y);
+            hash *= 16777619u;
+        }
+    return hash;
+}
+
+// With --check-counts the column and material counts a world keeps are compared with a scan of its cells.
+// The cells are read through a region so paged out chunks stay out. Returns 0 and says where when they
+// do not match.
+int countsMatch(World *w)
+{
+    Region *r;
+    createRegion(&r, w, 0, 0, w->width, w->height);
+    int ok = 1;
+    for (int x = 0; x < w->width && ok; ++x)
+    {
+        int count = 0, top = -1, lowest = w->height;
+        for (int y = 0; y < w->height; ++y)
+        {
+            if (r->type[(size_t) y * w->width + x] == EMPTY)
+            {
+                if (lowest == w->height) lowest = y;
+                continue;
+            }
+            count++;
+            top = y;
+        }
+        if (getColumnCount(w, x) != count || getColumnTop(w, x) != top || getColumnFree(w, x) != lowest)
+        {
+            printf("Column %d holds %d blocks up to row %d and is free from row %d, the counts say %d, %d and %d!\n",
+                   x, count, top, lowest, getColumnCount(w, x), getColumnTop(w, x), getColumnFree(w, x));
+            ok = 0;
+        }
+    }
+
+    for (int cy = 0; cy < w->chunksY && ok; ++cy)
+    {
+        for (int cx = 0; cx < w->chunksX && ok; ++cx)
+        {
+            int cells[BLOCK_TYPE_COUNT] = {0};
+            for (int y = cy << CHUNK_SHIFT; y < w->height && y < (cy + 1) << CHUNK_SHIFT; ++y)
+                for (int x = cx << CHUNK_SHIFT; x < w->width && x < (cx + 1) << CHUNK_SHIFT; ++x)
+                    cells[r->type[(size_t) y * w->width + x]]++;
+            ChunkStats s;
+            getChunkStats(w, cx, cy, &s);
+            for (int t = 0; t < BLOCK_TYPE_COUNT; ++t)
+            {
+                if (s.cells[t] == cells[t]) continue;
+                printf("Chunk %d, %d holds %d cells of %s, the counts say %d!\n", cx, cy, cells[t],
+                       materials[t].name, s.cells[t]);
+                ok = 0;
+                break;
+            }
+        }
+    }
+    destroyRegion(r);
+    return ok;
+}
+
+long peakMemoryKiB(void)
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+// With --profile every run gets its own profiler, written out as <prefix>-<name>-<threads>.csv/.json
+void startProfile(World *w)
+{
+    if (profilePrefix != NULL) createProfiler(&w->profiler);
+}
+
+void finishProfile(World *w, char *name)
+{
+    if (w->profiler == NULL) return;
+    char path[1024];
+    snprintf(path, sizeof(path), "%s-%s-%d.csv", profilePrefix, name, w->workers->threadCount);
+    if (!writeProfileCsv(w->profiler, path)) exit(1);
+    snprintf(path, sizeof(path), "%s-%s-%d.json", profilePrefix, name, w->workers->threadCount);
+    if (!writeProfileTrace(w->profiler, path)) exit(1);
+    destroyProfiler(w->profiler);
+    w->profiler = NULL;
+}
+
+// With --capture every run is rendered to <prefix>-<name>.y4m or .rgb. Nothing is dropped, the run
+// waits for the writer when it falls behind.
+Capture *capture = NULL;
+Frame *captured = NULL;
+
+void startCapture(World *w, char *name)
+{
+    if (capturePrefix == NULL) return;
+    char path[1024];
+    snprintf(path, sizeof(path), "%s-%s.%s", capturePrefix, name, captureFormat == CAPTURE_Y4M ? "y4m" : "rgb");
+    int fps = 60 / captureEvery;
+    if (!createCapture(&capture, path, captureFormat, w->width, w->height, fps > 0 ? fps : 1)) exit(1);
+    capture->every = captureEvery;
+    createFrame(&captured, w->width, w->height);
+}
+
+void captureTick(World *w)
+{
+    if (capture == NULL) return;
+    if (isCaptureDue(capture)) renderFrame(w, captured);
+    captureFrame(capture, captured);
+}
+
+void finishCapture(void)
+{
+    if (capture == NULL) return;
+    destroyCapture(capture);
+    destroyFrame(captured);
+    capture = NULL;
+    captured = NULL;
+}
+
+double runScenario(Scenario *s, int width, int height, int ticks, uint64_t seed, ThreadPool *workers,
+                   double baseline)
+{
+    World *w;
+    if (loadPath != NULL)
+    {
+        double loadStart = get_secs();
+        if (!loadWorld(&w, loadPath)) exit(1);
+        width = w->width;
+        height = w->height;
+        printf("Loaded %s (%dx%d, tick %llu) in %.2f ms\n", loadPath, width, height,
+               (unsigned long long) w->tick, 1e3 * (get_secs() - loadStart));
+    }
+    else
+    {
+        createWorld(&w, width, height);
+        seedWorld(w, seed);
+    }
+    w->workers = workers;
+    w->sleepChunks = sleepChunks;
+    w->engine = engine;
+    w->dispersion = dispersion;
+    w->fallSpeed = fallSpeed;
+    if (pageAfter > 0 && !setChunkPaging(w, pageAfter, pagePath)) exit(1);
+
+    if (s->setup != NULL) s->setup(w);
+    startProfile(w);
+    startCapture(w, s->name);
+
+    long awakeChunks = 0;
+    int ran = 0;
+    double start = get_secs();
+    while (ran < ticks)
+    {
+        if (s->step != NULL) s->step(w, ran);
+        uint64_t tickStart = beginTimer(w->profiler);
+        simulate(w);
+        endTimer(w->profiler, PROFILE_SIMULATE, tickStart);
+        awakeChunks += w->awakeChunks;
+        captureTick(w);
+        ran++;
+        // With --until-settled the ticks column shows when the world came to rest
+        if (untilSettled && isWorldSettled(w)) break;
+    }
+    ticks = ran;
+    double elapsed = get_secs() - start;
+    finishProfile(w, s->name);
+    finishCapture();
+
+    // Taken before the checksum, which pages every chunk back in
+    PoolStats ps;
+    getWorldAllocStats(w, &ps);
+    WorldStats stats;
+    getWorldStats(w, &stats);
+    int coldChunks = w->coldChunks;
+    size_t memory = getWorldMemory(w);
+
+    if (checkCounts && !countsMatch(w)) badCounts++;
+
+    double ticksPerSecond = ticks / elapsed;
+    lastChecksum = worldChecksum(w);
+    printf("%-8s %7d %8d %12.1f %7.2fx %10.3f %10llu %8d %8d %6d %8.1f %10zu   %08x\n", s->name,
+           workers->threadCount, ticks, ticksPerSecond, baseline > 0 ? ticksPerSecond / baseline : 1.0,
+           1e9 * elapsed / ((double) ticks * width * height), (unsigned long long) stats.blocks, ps.highWater,
+           ps.live, coldChunks, (double) awakeChunks / ticks, memory / 1024, lastChecksum);
+
+    if (savePrefix != NULL)
+    {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s-%s.pxs", savePrefix, s->name);
+        if (!saveWorld(w, path)) exit(1);
+    }
+
+    destroyWorld(w);
+    return ticksPerSecond;
+}
+
+// Plays a recorded session as fast as possible, the ticks column counts frames
+double runReplay(ThreadPool *workers, double baseline)
+{
+    Replay *replay;
+    if (!createReplay(&replay, replayPath)) exit(1);
+
+    World *w;
+    createWorld(&w, replay->width, replay->height);
+    seedWorld(w, replay->seed);
+    w->workers = workers;
+    w->sleepChunks = sleepChunks;
+    if (pageAfter > 0 && !setChunkPaging(w, pageAfter, pagePath)) exit(1);
+
+    Controls controls;
+    initControls(&controls);
+    startProfile(w);
+    startCapture(w, "replay");
+
+    long awakeChunks = 0;
+    int frames = 0;
+    double start = get_secs();
+    while (replayFrame(replay, &controls))
+    {
+        runFrame(w, &controls);
+        awakeChunks += w->awakeChunks;
+        captureTick(w);
+        frames++;
+    }
+    double elapsed = get_secs() - start;
+    finishProfile(w, "replay");
+    finishCapture();
+    if (frames == 0) frames = 1;
+
+    // Taken before the checksum, which pages every chunk back in
+    PoolStats ps;
+    getWorldAllocStats(w, &ps);
+    WorldStats stats;
+    getWorldStats(w, &stats);
+    int coldChunks = w->coldChunks;
+    size_t memory = getWorldMemory(w);
+
+    double framesPerSecond = frames / elapsed;
+    printf("%-8s %7d %8d %12.1f %7.2fx %10.3f %10llu %8d %8d %6d %8.1f %10zu   %08x\n", "replay",
+           workers->threadCount, frames, framesPerSecond, baseline > 0 ? framesPerSecond / baseline : 1.0,
+           1e9 * elapsed / ((double) frames * w->width * w->height), (unsigned long long) stats.blocks,
+           ps.highWater, ps.live, coldChunks, (double) awakeChunks / frames, memory / 1024, worldChecksum(w));
+
+    if (savePrefix != NULL)
+    {
+        char path[1024];
+        snprintf(path, sizeof(path), "%s-replay.pxs", savePrefix);
+        if (!saveWorld(w, path)) exit(1);
+    }
+
+    destroyWorld(w);
+    destroyReplay(replay);
+    return framesPerSecond;
+}
+
+// Reads one job per line as name followed by key=value settings, lines starting with # are left out.
+// Returns the number of jobs, 0 on errors.
+int readJobs(char *path, Job *defaults, Job **jobs)
+{
+    FILE *file = fopen(path, "r");
+    if (file == NULL)
+    {
+        printf("Could not open job file %s!\n", path);
+        return 0;
+    }
+
+    int count = 0, capacity = 16;
+    Job *list = malloc(capacity * sizeof(Job));
+    char line[1024];
+    int lineNumber = 0, ok = 1;
+    while (ok && fgets(line, sizeof(line), file) != NULL)
+    {
+        lineNumber++;
+        char *save;
+        char *token = strtok_r(line, " \t\r\n", &save);
+        if (token == NULL || token[0] == '#') continue;
+
+        Job *grown = list;
+        if (count == capacity)
+        {
+            capacity *= 2;
+            grown = realloc(list, capacity * sizeof(Job));
+        }
+        if (grown == NULL)
+        {
+            printf("Could not allocate jobs!\n");
+            exit(1);
+        }
+        list = grown;
+        Job *job = &list[count++];
+        *job = *defaults;
+        if (strlen(token) >= sizeof(job->name) || strchr(token, '/') != NULL || strchr(token, '=') != NULL)
+        {
+            printf("Bad job name %s on line %d!\n", token, lineNumber);
+            ok = 0;
+            break;
+        }
+        strcpy(job->name, token);
+        // Every job writes <name>.pxs, two jobs of the same name would overwrite each other's world
+        for (int i = 0; i < count - 1 && ok; ++i)
+        {
+            if (strcmp(list[i].name, job->name) != 0) continue;
+            printf("Job %s on line %d has the same name as an earlier job!\n", job->name, lineNumber);
+            ok = 0;
+        }
+        if (!ok) break;
+
+        while (ok && (token = strtok_r(NULL, " \t\r\n", &save)) != NULL)
+        {
+            char *value = strchr(token, '=');
+            if (value == NULL)
+            {
+                printf("Expected key=value instead of %s on line %d!\n", token, lineNumber);
+                ok = 0;
+                break;
+            }
+            *value++ = '\0';
+            if (strcmp(token, "scenario") == 0)
+            {
+                job->scenario = NULL;
+                for (int s = 0; s < SCENARIO_COUNT; ++s)
+                {
+                    if (strcmp(value, scenarios[s].name) == 0) job->scenario = &scenarios[s];
+                }
+                if (job->scenario == NULL && strcmp(value, "empty") != 0) ok = 0;
+            }
+            else if (strcmp(token, "load") == 0)
+            {
+                free(job->loadPath);
+                job->loadPath = strdup(value);
+            }
+            else if (strcmp(token, "width") == 0) job->width = atoi(value);
+            else if (strcmp(token, "height") == 0) job->height = atoi(value);
+            else if (strcmp(token, "ticks") == 0) job->ticks = atoi(value);
+            else if (strcmp(token, "seed") == 0) job->seed = strtoull(value, NULL, 10);
+            else if (strcmp(token, "dispersion") == 0) job->dispersion = atoi(value);
+            else if (strcmp(token, "fall-speed") == 0) job->fallSpeed = atoi(value);
+            else if (strcmp(token, "rain") == 0) job->rain = atoi(value);
+            else if (strcmp(token, "until-settled") == 0) job->untilSettled = atoi(value);
+            else if (strcmp(token, "engine") == 0)
+            {
+                if (strcmp(value, "cells") == 0) job->engine = ENGINE_CELLS;
+                else if (strcmp(value, "bitplanes") == 0) job->engine = ENGINE_BITPLANES;
+                else ok = 0;
+            }
+            else ok = 0;
+            if (!ok) printf("Bad job setting %s=%s on line %d!\n", token, value, lineNumber);
+        }
+        if (ok && (job->width <= 0 || job->height <= 0 || job->ticks <= 0 || job->dispersion < 1 ||
+                   job->dispersion > MAX_DISPERSION || job->fallSpeed < 1 || job->fallSpeed > MAX_FALL_SPEED ||
+                   job->rain < 0))
+        {
+            printf("Bad job settings on line %d!\n", lineNumber);
+            ok = 0;
+        }
+    }
+    fclose(file);
+
+    if (!ok || count == 0)
+    {
+        if (ok) printf("No jobs in %s!\n", path);
+        for (int i = 0; i < count; ++i) free(list[i].loadPath);
+        free(list);
+        return 0;
+    }
+    *jobs = list;
+    return count;
+}
+
+// Runs a whole job on the worker that claimed it. Each world runs on a single thread, the pool only
+// spreads the worlds.
+void runJobTask(void *context, int index, int worker)
+{
+    Batch *batch = context;
+    Job *job = &batch->jobs[batch->order[index]];
+    (void) worker;
+
+    double start = get_secs();
+    World *w;
+    if (job->loadPath != NULL)
+    {
+        if (!loadWorld(&w, job->loadPath))
+        {
+            job->ran = -1;
+            return;
+        }
+        job->width = w->width;
+        job->height = w->height;
+    }
+    else
+    {
+        createWorld(&w, job->width, job->height);
+        seedWorld(w, job->seed);
+    }
+    w->workers = NULL;
+    w->sleepChunks = sleepChunks;
+    w->engine = job->engine;
+    w->dispersion = job->dispersion;
+    w->fallSpeed = job->fallSpeed;
+    if (job->scenario != NULL && job->scenario->setup != NULL) job->scenario->setup(w);
+
+    while (job->ran < job->ticks)
+    {
+        if (job->scenario != NULL && job->scenario->step != NULL) job->scenario->step(w, job->ran);
+        for (int i = 0; i < job->rain; ++i) rain(w);
+        simulate(w);
+        job->ran++;
+        if (isWorldSettled(w))
+        {
+            if (job->settledAt == 0) job->settledAt = w->tick;
+            if (job->untilSettled) break;
+        }
+    }
+    job->seconds = get_secs() - start;
+    getWorldStats(w, &job->stats);
+    job->checksum = worldChecksum(w);
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s.pxs", outDir, job->name);
+    job->saved = saveWorld(w, path);
+    destroyWorld(w);
+    printf("%-16s %8d %10llu %10.1f   %08x\n", job->name, job->ran, (unsigned long long) job->settledAt,
+           1e3 * job->seconds, job->checksum);
+}
+
+double getJobCost(Job *job)
+{
+    return (double) job->width * job->height * job->ticks;
+}
+
+int writeBatchResults(Batch *batch, char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        printf("Could not write results %s!\n", path);
+        return 0;
+    }
+    fprintf(file, "job,width,height,seed,ticks,settled_at,seconds,ticks_per_s,blocks");
+    for (int t = 1; t < BLOCK_TYPE_COUNT; ++t) fprintf(file, ",%s", materials[t].name);
+    fprintf(file, ",moved,awake_chunks,checksum,snapshot\n");
+    for (int i = 0; i < batch->count; ++i)
+    {
+        Job *job = &batch->jobs[i];
+        if (job->ran < 0) continue;
+        fprintf(file, "%s,%d,%d,%llu,%d,%llu,%.4f,%.1f,%llu", job->name, job->width, job->height,
+                (unsigned long long) job->seed, job->ran, (unsigned long long) job->settledAt, job->seconds,
+                job->ran / job->seconds, (unsigned long long) job->stats.blocks);
+        for (int t = 1; t < BLOCK_TYPE_COUNT; ++t) fprintf(file, ",%llu", (unsigned long long) job->stats.cells[t]);
+        fprintf(file, ",%llu,%d,%08x,%s%s\n", (unsigned long long) job->stats.moved, job->stats.awakeChunks,
+                job->checksum, job->saved ? job->name : "", job->saved ? ".pxs" : "");
+    }
+    return fclose(file) == 0;
+}
+
+// Runs every job of the file on its own world, as many at once as there are threads. The results go to
+// outDir as a snapshot per job and results.csv.
+int runBatch(char *path, Job *defaults, int threads)
+{
+    Batch batch;
+    batch.count = readJobs(path, defaults, &batch.jobs);
+    if (batch.count == 0) return 0;
+    if (mkdir(outDir, 0777) != 0 && errno != EEXIST)
+    {
+        printf("Could not create %s!\n", outDir);
+        return 0;
+    }
+
+    // Starting the biggest worlds first keeps a long one from being picked up last and running alone
+    batch.order = malloc(batch.count * sizeof(int));
+    for (int i = 0; i < batch.count; ++i)
+    {
+        int j = i;
+        while (j > 0 && getJobCost(&batch.jobs[batch.order[j - 1]]) < getJobCost(&batch.jobs[i]))
+        {
+            batch.order[j] = batch.order[j - 1];
+            j--;
+        }
+        batch.order[j] = i;
+    }
+
+    printf("%d jobs from %s on %d threads\n", batch.count, path, threads);
+    printf("%-16s %8s %10s %10s   %s\n", "job", "ticks", "settled", "ms", "checksum");
+    ThreadPool *pool;
+    createThreadPool(&pool, threads);
+    double start = get_secs();
+    runTasks(pool, batch.count, runJobTask, &batch);
+    double elapsed = get_secs() - start;
+    destroyThreadPool(pool);
+
+    uint64_t ticks = 0, cells = 0;
+    int failed = 0;
+    for (int i = 0; i < batch.count; ++i)
+    {
+        Job *job = &batch.jobs[i];
+        if (job->ran < 0 || !job->saved) failed++;
+        if (job->ran < 0) continue;
+        ticks += job->ran;
+        cells += (uint64_t) job->ran * job->width * job->height;
+    }
+    printf("%d jobs in %.2f s, %.1f jobs/s, %.0f ticks/s, %.3f ns/cell\n", batch.count, elapsed,
+           batch.count / elapsed, ticks / elapsed, cells > 0 ? 1e9 * elapsed / cells : 0.0);
+
+    char resultsPath[1024];
+    snprintf(resultsPath, sizeof(resultsPath), "%s/results.csv", outDir);
+    int ok = writeBatchResults(&batch, resultsPath) && failed == 0;
+    for (int i = 0; i < batch.count; ++i) free(batch.jobs[i].loadPath);
+    free(batch.jobs);
+    free(batch.order);
+    return ok;
+}
+
+void usage(char *program)
+{
+    printf("Usage: %s [--ticks n] [--seed n] [--width n] [--height n] [--threads n] [--scaling] [--no-sleep] [--engine cells|bitplanes]\n       [--load file] [--save prefix] [--replay file] [--page ticks] [--page-file path] [--profile prefix]\n       [--dispersion n] [--fall-speed n] [--until-settled] [--compare-engines] [--check-counts]\n       [--capture prefix] [--capture-every n] [--capture-format y4m|rgb] [scenario...]\n       %s --batch jobs [--out dir] [--threads n] [defaults...]\n",
+           program, program);
+    printf("Scenarios:");
+    for (int i = 0; i < SCENARIO_COUNT; ++i) printf(" %s", scenarios[i].name);
+    printf("\n");
+}
+
+int main(int argc, char **argv)
+{
+    int width = 320;
+    int height = 200;
+    int ticks = 1000;
+    uint64_t seed = 1;
+    int threads = 1;
+    int scaling = 0;
+    int selected[SCENARIO_COUNT] = {0};
+    int anySelected = 0;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (i + 1 < argc && strcmp(argv[i], "--ticks") == 0) ticks = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0) seed = strtoull(argv[++i], NULL, 10);
+        else if (i + 1 < argc && strcmp(argv[i], "--width") == 0) width = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--height") == 0) height = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--scaling") == 0) scaling = 1;
+        else if (strcmp(argv[i], "--no-sleep") == 0) sleepChunks = 0;
+        else if (strcmp(argv[i], "--until-settled") == 0) untilSettled = 1;
+        else if (strcmp(argv[i], "--compare-engines") == 0) compareEngines = 1;
+        else if (strcmp(argv[i], "--check-counts") == 0) checkCounts = 1;
+        else if (i + 1 < argc && strcmp(argv[i], "--load") == 0) loadPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--save") == 0) savePrefix = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--replay") == 0) replayPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--page") == 0) pageAfter = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--page-file") == 0) pagePath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--profile") == 0) profilePrefix = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--dispersion") == 0) dispersion = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--fall-speed") == 0) fallSpeed = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--batch") == 0) batchPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--out") == 0) outDir = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--capture") == 0) capturePrefix = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--capture-every") == 0) captureEvery = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--capture-format") == 0)
+        {
+            ++i;
+            if (strcmp(argv[i], "y4m") == 0) captureFormat = CAPTURE_Y4M;
+            else if (strcmp(argv[i], "rgb") == 0) captureFormat = CAPTURE_RGB;
+            else
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else if (i + 1 < argc && strcmp(argv[i], "--engine") == 0)
+        {
+            ++i;
+            if (strcmp(argv[i], "cells") == 0) engine = ENGINE_CELLS;
+            else if (strcmp(argv[i], "bitplanes") == 0) engine = ENGINE_BITPLANES;
+            else
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+        else
+        {
+            int found = 0;
+            for (int s = 0; s < SCENARIO_COUNT; ++s)
+            {
+                if (strcmp(argv[i], scenarios[s].name) == 0)
+                {
+                    selected[s] = 1;
+                    anySelected = found = 1;
+                }
+            }
+            if (!found)
+            {
+                usage(argv[0]);
+                return 1;
+            }
+        }
+    }
+    if (width <= 0 || height <= 0 || ticks <= 0 || threads <= 0 || captureEvery <= 0 || dispersion < 1 ||
+        dispersion > MAX_DISPERSION || fallSpeed < 1 || fallSpeed > MAX_FALL_SPEED)
+    {
+        usage(argv[0]);
+        return 1;
+    }
+
+    // The command line settings become the defaults of every job
+    if (batchPath != NULL)
+    {
+        Job defaults;
+        memset(&defaults, 0, sizeof(Job));
+        defaults.width = width;
+        defaults.height = height;
+        defaults.ticks = ticks;
+        defaults.seed = seed;
+        defaults.engine = engine;
+        defaults.dispersion = dispersion;
+        defaults.fallSpeed = fallSpeed;
+        defaults.untilSettled = untilSettled;
+        defaults.loadPath = NULL;
+        return runBatch(batchPath, &defaults, threads) ? 0 : 1;
+    }
+
+    if (replayPath != NULL) printf("Replaying %s\n", replayPath);
+    else
+        printf("World %dx%d, %s%d ticks, seed %llu, %s engine, dispersion %d, fall speed %d\n", width, height,
+               untilSettled ? "until settled or " : "", ticks, (unsigned long long) seed,
+               compareEngines ? "cell and bitplane" : engine == ENGINE_BITPLANES ? "bitplane" : "cell", dispersion,
+               fallSpeed);
+    // With --scaling every scenario runs on 1, 2, 4, ... threads up to the requested count
+    int threadCounts[32];
+    int runs = 0;
+    for (int t = scaling ? 1 : threads; t < threads && runs < 31; t *= 2) threadCounts[runs++] = t;
+    threadCounts[runs++] = threads;
+
+    ThreadPool *pools[32];
+    for (int r = 0; r < runs; ++r) createThreadPool(&pools[r], threadCounts[r]);
+
+    printf("%-8s %7s %8s %12s %8s %10s %10s %8s %8s %6s %8s %10s   %s\n", "scenario", "threads", "ticks",
+           "ticks/s", "speedup", "ns/cell", "blocks", "chunks", "live", "cold", "awake", "mem KiB", "checksum");
+    // A recording or a loaded snapshot replaces the built-in scenarios
+    if (replayPath != NULL)
+    {
+        double baseline = 0;
+        for (int r = 0; r < runs; ++r)
+        {
+            double framesPerSecond = runReplay(pools[r], baseline);
+            if (r == 0) baseline = framesPerSecond;
+        }
+    }
+    // With --compare-engines every run is done with both engines, which have to end up with the same world
+    int mismatches = 0;
+    // How many times faster the bitplane engine got through a tick of each scenario, over all runs
+    char speedups[SCENARIO_COUNT * 32] = "";
+    for (int s = 0; s < SCENARIO_COUNT && replayPath == NULL; ++s)
+    {
+        if (loadPath != NULL ? s > 0 : anySelected && !selected[s]) continue;
+        Scenario *scenario = loadPath != NULL ? &snapshotScenario : &scenarios[s];
+        double baseline = 0, cellsTick = 0, bitplanesTick = 0;
+        for (int r = 0; r < runs; ++r)
+        {
+            if (compareEngines) engine = ENGINE_CELLS;
+            double ticksPerSecond = runScenario(scenario, width, height, ticks, seed, pools[r], baseline);
+            if (r == 0) baseline = ticksPerSecond;
+            if (!compareEngines) continue;
+
+            uint32_t cellsChecksum = lastChecksum;
+            engine = ENGINE_BITPLANES;
+            cellsTick += 1 / ticksPerSecond;
+            bitplanesTick += 1 / runScenario(scenario, width, height, ticks, seed, pools[r], baseline);
+            if (lastChecksum != cellsChecksum)
+            {
+                printf("%s: the bitplane engine ended with %08x instead of %08x!\n", scenario->name, lastChecksum,
+                       cellsChecksum);
+                mismatches++;
+            }
+        }
+        if (compareEngines)
+        {
+            size_t used = strlen(speedups);
+            snprintf(speedups + used, sizeof(speedups) - used, " %s %.2fx", scenario->name,
+                     cellsTick / bitplanesTick);
+        }
+    }
+    if (speedups[0] != 0) printf("Bitplanes over cells:%s\n", speedups);
+    printf("Peak memory: %ld KiB\n", peakMemoryKiB());
+
+    for (int r = 0; r < runs; ++r) destroyThreadPool(pools[r]);
+
+    return mismatches > 0 || badCounts > 0;
+}
@@ -0,0 +1,319 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include "bitplane.h"
+#include "simulate.h"
+
+// Empty, water and other cells of 64 cells of a row
+typedef struct RowPlanes_
+{
+    uint64_t empty;
+    uint64_t water;
+    uint64_t other;
+} RowPlanes;
+
+// A chunk row in the order the per-cell scan visits it, bit i is the i-th cell it reaches. prev holds the
+// row of the chunk the scan comes from and next the one it goes on to, so the last bit of prev and the
+// first bit of next are the cells right before and after the chunk.
+typedef struct ScanRow_
+{
+    RowPlanes here;
+    RowPlanes prev;
+    RowPlanes next;
+} ScanRow;
+
+// Columns of chunk column cx that lie inside the world
+static inline uint64_t getValidColumns(World *w, int cx)
+{
+    int columns = w->width - (cx << CHUNK_SHIFT);
+    return columns >= CHUNK_SIZE ? ~0ULL : (1ULL << columns) - 1;
+}
+
+// The row kernels know the rules of these materials only, cells with anything else close by go through
+// the per-cell rules
+static inline uint64_t getOtherMaterials(Chunk *c, int row)
+{
+    uint64_t known = __atomic_load_n(&c->material[CONCRETE][row], __ATOMIC_RELAXED) |
+                     __atomic_load_n(&c->material[SAND][row], __ATOMIC_RELAXED) |
+                     __atomic_load_n(&c->material[WATER][row], __ATOMIC_RELAXED);
+    return __atomic_load_n(&c->occupied[row], __ATOMIC_RELAXED) & ~known;
+}
+
+// Cells of world row y in chunk column cx, following the same rules as getBlockType: the walls and the
+// floor are never empty. Other workers may be writing the row words of neighbouring chunks, so they are
+// loaded atomically.
+static void getRowPlanes(World *w, int cx, int y, RowPlanes *p)
+{
+    *p = (RowPlanes) {0, 0, 0};
+    if (y < 0 || cx < 0 || cx >= w->chunksX) return;
+
+    uint64_t valid = getValidColumns(w, cx);
+    Chunk *c = y < w->height ? getChunk(w, cx << CHUNK_SHIFT, y) : NULL;
+    if (c == NULL)
+    {
+        p->empty = valid;
+        return;
+    }
+    int row = y & CHUNK_MASK;
+    p->empty = ~__atomic_load_n(&c->occupied[row], __ATOMIC_RELAXED) & valid;
+    p->water = __atomic_load_n(&c->material[WATER][row], __ATOMIC_RELAXED);
+    p->other = getOtherMaterials(c, row);
+}
+
+static inline uint64_t reverseBits(uint64_t v)
+{
+    v = ((v >> 1) & 0x5555555555555555ULL) | ((v & 0x5555555555555555ULL) << 1);
+    v = ((v >> 2) & 0x3333333333333333ULL) | ((v & 0x3333333333333333ULL) << 2);
+    v = ((v >> 4) & 0x0F0F0F0F0F0F0F0FULL) | ((v & 0x0F0F0F0F0F0F0F0FULL) << 4);
+    return __builtin_bswap64(v);
+}
+
+// A row word of this chunk in scan order
+static inline uint64_t toScan(uint64_t v, int reverse)
+{
+    return reverse ? reverseBits(v) : v;
+}
+
+static void reversePlanes(RowPlanes *p)
+{
+    p->empty = reverseBits(p->empty);
+    p->water = reverseBits(p->water);
+    p->other = reverseBits(p->other);
+}
+
+// The neighbouring chunks are only loaded when asked for
+static void getScanRow(World *w, int cx, int y, int reverse, int neighbours, ScanRow *r)
+{
+    getRowPlanes(w, cx, y, &r->here);
+    r->prev = (RowPlanes) {0, 0, 0};
+    r->next = (RowPlanes) {0, 0, 0};
+    if (neighbours)
+    {
+        getRowPlanes(w, reverse ? cx + 1 : cx - 1, y, &r->prev);
+        getRowPlanes(w, reverse ? cx - 1 : cx + 1, y, &r->next);
+    }
+    if (reverse)
+    {
+        reversePlanes(&r->here);
+        reversePlanes(&r->prev);
+        reversePlanes(&r->next);
+    }
+}
+
+// Bit i is set when the cell the scan reaches right before i is set
+static inline uint64_t fromPrev(uint64_t row, uint64_t prevRow)
+{
+    return (row << 1) | (prevRow >> (CHUNK_SIZE - 1));
+}
+
+// Bit i is set when the cell the scan reaches right after i is set
+static inline uint64_t fromNext(uint64_t row, uint64_t nextRow)
+{
+    return (row >> 1) | (nextRow << (CHUNK_SIZE - 1));
+}
+
+// The cells of runs that one of the heads, the first cells of their runs, carries through
+static inline uint64_t spreadRuns(uint64_t runs, uint64_t heads)
+{
+    return runs & ((runs + heads) ^ runs);
+}
+
+static inline int getScanX(int x0, int bit, int reverse)
+{
+    return x0 + (reverse ? CHUNK_MASK - bit : bit);
+}
+
+// Moves are made in scan order, dx is towards the next cell of the scan
+static void applyMoves(World *w, Chunk *c, int x0, int y, int reverse, uint64_t moves, int dx, int dy)
+{
+    if (reverse) dx = -dx;
+    while (moves)
+    {
+        int x = getScanX(x0, __builtin_ctzll(moves), reverse);
+        moves &= moves - 1;
+        moveAndMark(w, c, x, y, x + dx, y + dy);
+    }
+}
+
+static void applyFalls(World *w, Chunk *c, int x0, int y, int reverse, uint64_t falls)
+{
+    while (falls)
+    {
+        int x = getScanX(x0, __builtin_ctzll(falls), reverse);
+        falls &= falls - 1;
+        fallAndMark(w, c, getCellIndex(x, y), x, y);
+    }
+}
+
+static void clearSpeeds(Chunk *c, int x0, int y, int reverse, uint64_t cells)
+{
+    while (cells)
+    {
+        int x = getScanX(x0, __builtin_ctzll(cells), reverse);
+        cells &= cells - 1;
+        c->flags[getCellIndex(x, y)] &= ~BLOCK_SPEED;
+    }
+}
+
+// Blocks among the movers that would fall more than one cell, which leaves the cell right below them empty
+static uint64_t getFastFalls(World *w, Chunk *c, int x0, int y, int reverse, uint64_t falls, uint64_t below2)
+{
+    uint64_t fast = 0;
+    for (uint64_t cells = falls & below2; cells; cells &= cells - 1)
+    {
+        int bit = __builtin_ctzll(cells);
+        if (c->flags[getCellIndex(getScanX(x0, bit, reverse), y)] & BLOCK_SPEED) fast |= 1ULL << bit;
+    }
+    return fast;
+}
+
+// Same rules as simulateBlock for a stretch of movers of a chunk row, the cells of which are all of
+// materials the kernel knows about. All words are in scan order.
+//
+// Falling and sliding down diagonally go first. A cell sliding towards the next cell takes the cell below
+// it before that one gets to fall, and that one then slides too, so runs of sand over a gap move together.
+// The runs are carried through with an add. Going forwards every cell only depends on the cells before it
+// and this settles after a few passes. Going backwards sliding towards the next cell, which is the left
+// one, comes first and does not depend on the other slides at all.
+//
+// Water that cannot fall steps aside at a dispersion of 1. A cell with room before it steps back into it,
+// leaving room for the one after it, so a run of water with room before it flows back as a whole and only
+// its last cell can step forwards as well. Where both sides are free the per-cell rules flip a coin, and
+// the coins are drawn here in the same order. Only scans going forwards get here with water stepping aside.
+static void simulateStretch(World *w, Chunk *c, int x0, int y, int reverse, uint64_t movers, uint64_t sand,
+                            uint64_t water, const ScanRow *here, const ScanRow *below, uint64_t below2, Rng *rng)
+{
+    uint64_t empty = below->here.empty;
+    uint64_t emptyPrev = fromPrev(empty, below->prev.empty), emptyNext = fromNext(empty, below->next.empty);
+    uint64_t fast = w->fallSpeed > 1 ? getFastFalls(w, c, x0, y, reverse, movers & empty, below2) : 0;
+
+    uint64_t fall, toPrev, toNext = 0;
+    if (!reverse)
+    {
+        for (;;)
+        {
+            fall = movers & empty & ~(toNext << 1);
+            toPrev = sand & ~fall & emptyPrev & ~((movers & empty & ~fast) << 1) & ~(toNext << 2);
+            uint64_t heads = sand & ~empty & emptyNext & ~toPrev;
+            uint64_t runs = heads | (sand & empty & emptyNext);
+            uint64_t slide = spreadRuns(runs, heads);
+            if (slide == toNext) break;
+            toNext = slide;
+        }
+    }
+    else
+    {
+        uint64_t heads = sand & ~empty & emptyNext;
+        toNext = spreadRuns(heads | (sand & empty & emptyNext), heads);
+        fall = movers & empty & ~(toNext << 1);
+        toPrev = sand & ~fall & ~toNext & emptyPrev & ~((movers & empty & ~fast) << 1) & ~(toNext << 2);
+    }
+
+    uint64_t flowPrev = 0, flowNext = 0;
+    uint64_t side = water & ~fall;
+    if (w->dispersion == 1 && side)
+    {
+        uint64_t free = here->here.empty;
+        uint64_t heads = side & ~(side << 1), ends = side & ~(side >> 1);
+        // Whether there is room before a run that comes right after another run and a free cell is only
+        // known once the run before has decided whether to step into that cell
+        uint64_t chained = heads & (free << 1) & (side << 2);
+        uint64_t left = free | fall | toPrev | toNext;
+        flowPrev = spreadRuns(side, heads & fromPrev(left, here->prev.empty) & ~chained);
+        for (uint64_t gaps = ends & fromNext(free, here->next.empty); gaps; gaps &= gaps - 1)
+        {
+            uint64_t bit = gaps & -gaps;
+            // The last cell of a run flowing back flips a coin, heads goes forwards like in the per-cell rules
+            if (!(flowPrev & bit) || randomBit(rng)) flowNext |= bit;
+            else if (chained & (bit << 2)) flowPrev |= spreadRuns(side, bit << 2);
+        }
+        flowPrev &= ~flowNext;
+    }
+
+    // Anything but falling straight on stops a falling block
+    if (w->fallSpeed > 1)
+    {
+        clearSpeeds(c, x0, y, reverse, movers & ~fall);
+        applyFalls(w, c, x0, y, reverse, fall);
+    }
+    else
+    {
+        applyMoves(w, c, x0, y, reverse, fall, 0, -1);
+    }
+    applyMoves(w, c, x0, y, reverse, toPrev, -1, -1);
+    applyMoves(w, c, x0, y, reverse, toNext, 1, -1);
+    applyMoves(w, c, x0, y, reverse, flowPrev, -1, 0);
+    applyMoves(w, c, x0, y, reverse, flowNext, 1, 0);
+}
+
+// Same rules as simulateBlock, evaluated a chunk row at a time and in the same order as the per-cell scan,
+// which runs backwards on every other tick when liquids flow further than a cell. A row is handled in
+// stretches: movers the kernel has no rules for go through the per-cell rules one by one, the stretches
+// between them through the kernel. Every stretch reloads the rows, so it sees what the ones before it did.
+//
+// The per-cell rules are needed for cells of other materials or with other materials around, sand that may
+// get into water, and at a dispersion above 1 for water that may flow sideways.
+void simulateChunkBitplanes(World *w, Chunk *c, int cx, int cy, Rng *rng)
+{
+    int x0 = cx << CHUNK_SHIFT, y0 = cy << CHUNK_SHIFT;
+    int rows = w->height - y0;
+    if (rows > CHUNK_SIZE) rows = CHUNK_SIZE;
+    int reverse = w->dispersion > 1 && (w->tick & 1);
+    uint64_t valid = toScan(getValidColumns(w, cx), reverse);
+
+    for (int row = 0; row < rows; ++row)
+    {
+        int y = y0 + row;
+        int start = 0;
+        while (start < CHUNK_SIZE)
+        {
+            uint64_t movers = toScan(c->gravity[row] & ~c->updated[row], reverse) & valid & (~0ULL << start);
+            if (movers == 0) break;
+
+            ScanRow here, below, below2 = {{0, 0, 0}, {0, 0, 0}, {0, 0, 0}};
+            getScanRow(w, cx, y, reverse, 1, &here);
+            getScanRow(w, cx, y - 1, reverse, 1, &below);
+            if (w->fallSpeed > 1) getScanRow(w, cx, y - 2, reverse, 0, &below2);
+            uint64_t sand = movers & toScan(c->material[SAND][row], reverse);
+            uint64_t water = movers & here.here.water;
+            uint64_t empty = below.here.empty;
+
+            uint64_t otherBelow = below.here.other | fromPrev(below.here.other, below.prev.other) |
+                                  fromNext(below.here.other, below.next.other);
+            // Water falling in ahead of sand ends up below it on the side too
+            uint64_t waterBelow = below.here.water | fromPrev(below.here.water, below.prev.water) |
+                                  fromNext(below.here.water, below.next.water) | fromPrev(water & empty, 0);
+            uint64_t complex = (movers & (here.here.other | otherBelow)) | (sand & waterBelow) |
+                               (water & (fromPrev(here.here.other, here.prev.other) |
+                                         fromNext(here.here.other, here.next.other)));
+            if (w->dispersion > 1)
+            {
+                // Unless it surely falls, water with a cell on either side that is or may become free
+                uint64_t falls = empty & ~fromPrev(sand, 0);
+                complex |= water & ~falls & (fromPrev(here.here.empty | movers, here.prev.empty) |
+                                             fromNext(here.here.empty, here.next.empty));
+            }
+
+            int end = complex ? __builtin_ctzll(complex) : CHUNK_SIZE;
+            uint64_t stretch = end < CHUNK_SIZE ? movers & ((1ULL << end) - 1) : movers;
+            if (stretch)
+            {
+                simulateStretch(w, c, x0, y, reverse, stretch, sand & stretch, water & stretch, &here, &below,
+                                below2.here.empty, rng);
+            }
+            if (end == CHUNK_SIZE) break;
+
+            // The per-cell rules up to the next mover the kernel can take again
+            uint64_t simple = movers & ~complex & (~0ULL << end);
+            int stop = simple ? __builtin_ctzll(simple) : CHUNK_SIZE;
+            uint64_t cells = movers & (~0ULL << end) & (stop < CHUNK_SIZE ? (1ULL << stop) - 1 : ~0ULL);
+            for (; cells; cells &= cells - 1)
+            {
+                int x = getScanX(x0, __builtin_ctzll(cells), reverse);
+                simulateBlock(w, c, getCellIndex(x, y), x, y, rng);
+            }
+            start = stop;
+        }
+    }
+}
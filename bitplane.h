@@ -0,0 +1,13 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_BITPLANE_H
+
+#include "world.h"
+
+void simulateChunkBitplanes(World *w, Chunk *c, int cx, int cy, Rng *rng);
+
+#define PIXSIM_BITPLANE_H
+
+#endif //PIXSIM_BITPLANE_H
@@ -2,23 +2,20 @@
 // Created by Snowp on 26/01/2023.
 //
 
-#include <stdlib.h>
-
 #include "block.h"
 
 
-void createBlock(Block **b, BlockType t)
-{
-    Block *nb;
-
-    nb = malloc(sizeof(Block));
-    nb->type = t;
-    nb->gravity = 1;
-
-    *b = nb;
-}
+const Material materials[BLOCK_TYPE_COUNT] = {
+        [EMPTY]    = {"empty",    STATE_GAS,    0,  0, {0,   0,   0}},
+        [CONCRETE] = {"concrete", STATE_SOLID,  30, 0, {255, 0,   0}},
+        [SAND]     = {"sand",     STATE_POWDER, 15, 1, {0,   255, 0}},
+        [WATER]    = {"water",    STATE_LIQUID, 10, 0, {0,   0,   255}},
+        [OIL]      = {"oil",      STATE_LIQUID, 8,  0, {96,  64,  16}},
+        [GRAVEL]   = {"gravel",   STATE_POWDER, 20, 0, {128, 128, 128}},
+        [SMOKE]    = {"smoke",    STATE_GAS,    1,  0, {200, 200, 200}},
+};
 
-void destroyBlock(Block *b)
+void getBlockColor(BlockType t, Color *c)
 {
-    free(b);
+    *c = materials[t].color;
 }
@@ -7,27 +7,63 @@
 #include "color.h"
 #include "vector.h"
 
-struct BlockEntry_;
-
 typedef enum BlockType_
 {
+    EMPTY,
     CONCRETE,
     SAND,
-    WATER
+    WATER,
+    OIL,
+    GRAVEL,
+    SMOKE,
+    BLOCK_TYPE_COUNT
 } BlockType;
 
+typedef enum MaterialState_
+{
+    // Stays put unless the cell below is empty
+    STATE_SOLID,
+    // Falls, piles up and sinks through lighter liquids and gases
+    STATE_POWDER,
+    // Falls and spreads sideways
+    STATE_LIQUID,
+    // Rises and spreads sideways
+    STATE_GAS
+} MaterialState;
+
+// Behaviour of a block type. Liquids and gases make way for denser materials, powders that slide
+// roll off to the sides and form slopes instead of columns.
+typedef struct Material_
+{
+    char *name;
+    MaterialState state;
+    int density;
+    int slides;
+    Color color;
+} Material;
+
+extern const Material materials[BLOCK_TYPE_COUNT];
+
+// Per-cell flag bits
+#define BLOCK_GRAVITY 0x01
+// Cells a falling block dropped last tick, 0 once it stopped
+#define BLOCK_SPEED 0x0E
+#define SPEED_SHIFT 1
+// The top bits of the flags pick one of the shades of the cell's material, so a cell is just its type
+// and flags byte
+#define SHADE_SHIFT 4
+#define MATERIAL_SHADES 16
+
+// Copy of a single cell, as handed out by getBlock
 typedef struct Block_
 {
-    struct BlockEntry_ *entry;
     BlockType type;
     PairInt location;
     int gravity;
     Color color;
 } Block;
 
-void createBlock(Block **b, BlockType t);
-
-void destroyBlock(Block *b);
+void getBlockColor(BlockType t, Color *c);
 
 #define PIXSIM_BLOCK_H
 
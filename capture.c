@@ -0,0 +1,173 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "capture.h"
+
+CaptureFormat getCaptureFormat(char *path)
+{
+    size_t length = strlen(path);
+    return length >= 4 && strcmp(path + length - 4, ".y4m") == 0 ? CAPTURE_Y4M : CAPTURE_RGB;
+}
+
+// Turns a frame of RGBA pixels into what goes into the file, Y4M frames as planes of BT.601 studio
+// range luma and chroma. Returns the number of bytes.
+static size_t convertFrame(Capture *c, const uint32_t *pixels)
+{
+    size_t cells = (size_t) c->width * c->height;
+    const uint8_t *rgba = (const uint8_t *) pixels;
+    uint8_t *out = c->converted;
+    if (c->format == CAPTURE_RGB)
+    {
+        for (size_t i = 0; i < cells; ++i)
+        {
+            out[3 * i] = rgba[4 * i];
+            out[3 * i + 1] = rgba[4 * i + 1];
+            out[3 * i + 2] = rgba[4 * i + 2];
+        }
+        return 3 * cells;
+    }
+
+    memcpy(out, "FRAME\n", 6);
+    uint8_t *y = out + 6, *u = y + cells, *v = u + cells;
+    for (size_t i = 0; i < cells; ++i)
+    {
+        int r = rgba[4 * i], g = rgba[4 * i + 1], b = rgba[4 * i + 2];
+        y[i] = (uint8_t) (((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+        u[i] = (uint8_t) (((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+        v[i] = (uint8_t) (((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+    }
+    return 6 + 3 * cells;
+}
+
+static void *writeFrames(void *arg)
+{
+    Capture *c = arg;
+    pthread_mutex_lock(&c->lock);
+    while (1)
+    {
+        while (c->head == c->tail && !c->closing) pthread_cond_wait(&c->ready, &c->lock);
+        if (c->head == c->tail) break;
+        uint32_t *pixels = c->slots[c->head % CAPTURE_QUEUE_SIZE];
+        pthread_mutex_unlock(&c->lock);
+
+        // The slot stays taken until the frame is converted, the disk is only touched after that
+        size_t size = convertFrame(c, pixels);
+        pthread_mutex_lock(&c->lock);
+        c->head++;
+        pthread_cond_signal(&c->room);
+        pthread_mutex_unlock(&c->lock);
+
+        int ok = fwrite(c->converted, 1, size, c->file) == size;
+        pthread_mutex_lock(&c->lock);
+        if (ok) c->written++;
+        else if (!c->failed)
+        {
+            printf("Could not write captured frame!\n");
+            c->failed = 1;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+int createCapture(Capture **c, char *path, CaptureFormat format, int width, int height, int fps)
+{
+    FILE *file = fopen(path, "wb");
+    if (file == NULL)
+    {
+        printf("Could not create capture %s!\n", path);
+        return 0;
+    }
+    if (format == CAPTURE_Y4M) fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width, height, fps);
+
+    Capture *nc;
+    nc = malloc(sizeof(Capture));
+    nc->file = file;
+    nc->format = format;
+    nc->width = width;
+    nc->height = height;
+    nc->every = 1;
+    nc->dropWhenFull = 0;
+    nc->offered = 0;
+    nc->written = 0;
+    nc->dropped = 0;
+    size_t cells = (size_t) width * height;
+    for (int i = 0; i < CAPTURE_QUEUE_SIZE; ++i)
+    {
+        nc->slots[i] = malloc(cells * sizeof(uint32_t));
+        if (nc->slots[i] == NULL)
+        {
+            printf("Could not allocate capture queue!\n");
+            exit(1);
+        }
+    }
+    nc->converted = malloc(6 + 3 * cells);
+    if (nc->converted == NULL)
+    {
+        printf("Could not allocate capture queue!\n");
+        exit(1);
+    }
+    nc->head = 0;
+    nc->tail = 0;
+    nc->closing = 0;
+    nc->failed = 0;
+    pthread_mutex_init(&nc->lock, NULL);
+    pthread_cond_init(&nc->ready, NULL);
+    pthread_cond_init(&nc->room, NULL);
+    if (pthread_create(&nc->thread, NULL, writeFrames, nc) != 0)
+    {
+        printf("Could not start capture thread!\n");
+        exit(1);
+    }
+
+    *c = nc;
+    return 1;
+}
+
+int isCaptureDue(Capture *c)
+{
+    return c->offered % (uint64_t) c->every == 0;
+}
+
+int captureFrame(Capture *c, Frame *f)
+{
+    int due = isCaptureDue(c);
+    c->offered++;
+    if (!due) return 0;
+
+    // Only this thread adds frames, so the tail slot is free to fill once there is room
+    pthread_mutex_lock(&c->lock);
+    while (c->tail - c->head == CAPTURE_QUEUE_SIZE && !c->dropWhenFull) pthread_cond_wait(&c->room, &c->lock);
+    int full = c->tail - c->head == CAPTURE_QUEUE_SIZE;
+    if (full) c->dropped++;
+    pthread_mutex_unlock(&c->lock);
+    if (full) return 0;
+
+    memcpy(c->slots[c->tail % CAPTURE_QUEUE_SIZE], f->pixels, (size_t) c->width * c->height * sizeof(uint32_t));
+    pthread_mutex_lock(&c->lock);
+    c->tail++;
+    pthread_cond_signal(&c->ready);
+    pthread_mutex_unlock(&c->lock);
+    return 1;
+}
+
+void destroyCapture(Capture *c)
+{
+    pthread_mutex_lock(&c->lock);
+    c->closing = 1;
+    pthread_cond_signal(&c->ready);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->thread, NULL);
+
+    if (fclose(c->file) != 0 && !c->failed) printf("Could not write captured frame!\n");
+    pthread_cond_destroy(&c->room);
+    pthread_cond_destroy(&c->ready);
+    pthread_mutex_destroy(&c->lock);
+    for (int i = 0; i < CAPTURE_QUEUE_SIZE; ++i) free(c->slots[i]);
+    free(c->converted);
+    free(c);
+}
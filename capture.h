@@ -0,0 +1,69 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_CAPTURE_H
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "render.h"
+
+// Frames waiting for the writer, each one holds a copy of the pixels
+#define CAPTURE_QUEUE_SIZE 16
+
+typedef enum CaptureFormat_
+{
+    // YUV4MPEG2 with full resolution chroma, ffmpeg and most players read it as it is
+    CAPTURE_Y4M,
+    // Bare RGB24 frames one after another, the size and rate have to be given to whatever reads them
+    CAPTURE_RGB
+} CaptureFormat;
+
+// Streams rendered frames to a file. Frames are copied into a bounded queue and converted and written
+// on a thread of its own, so a slow disk only ever holds up the writer.
+typedef struct Capture_
+{
+    FILE *file;
+    CaptureFormat format;
+    int width;
+    int height;
+    // Only every nth frame offered is kept
+    int every;
+    // When the queue is full: drop the frame when set, otherwise wait for the writer
+    int dropWhenFull;
+    uint64_t offered;
+    uint64_t written;
+    uint64_t dropped;
+    uint32_t *slots[CAPTURE_QUEUE_SIZE];
+    uint8_t *converted;
+    unsigned head;
+    unsigned tail;
+    int closing;
+    int failed;
+    pthread_mutex_t lock;
+    pthread_cond_t ready;
+    pthread_cond_t room;
+    pthread_t thread;
+} Capture;
+
+// .y4m files get Y4M, anything else raw RGB
+CaptureFormat getCaptureFormat(char *path);
+
+// Starts the writer thread, fps only goes into the Y4M header. Returns 0 when the file can not be
+// created.
+int createCapture(Capture **c, char *path, CaptureFormat format, int width, int height, int fps);
+
+// Set when the next frame offered to captureFrame is going to be kept, so callers can skip rendering
+// the others
+int isCaptureDue(Capture *c);
+
+// Offers a frame of the capture's size, returns 0 when it was left out
+int captureFrame(Capture *c, Frame *f);
+
+// Writes out the frames still queued and closes the file
+void destroyCapture(Capture *c);
+
+#define PIXSIM_CAPTURE_H
+
+#endif //PIXSIM_CAPTURE_H
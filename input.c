@@ -0,0 +1,164 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include "input.h"
+#include "simulate.h"
+#include "region.h"
+
+void initControls(Controls *c)
+{
+    c->mouseX = -1;
+    c->mouseY = -1;
+    c->mouseLDown = 0;
+    c->mouseRDown = 0;
+    c->mDown = 0;
+    c->qDown = 0;
+    c->raining = 0;
+    c->paused = 0;
+    c->brushSize = 1;
+    c->brushGravity = 1;
+    c->material = CONCRETE;
+    c->engine = ENGINE_CELLS;
+    c->dispersion = 1;
+    c->fallSpeed = 1;
+    c->lastPaintX = -1;
+    c->lastPaintY = -1;
+    c->reset = 0;
+}
+
+int getInputButtons(Controls *c)
+{
+    return (c->mouseLDown ? 1 : 0) | (c->mouseRDown ? 2 : 0) | (c->mDown ? 4 : 0) | (c->qDown ? 8 : 0);
+}
+
+void applyInput(Controls *c, InputEvent *e)
+{
+    switch (e->type)
+    {
+        case INPUT_MOUSE:
+            c->mouseX = e->x;
+            c->mouseY = e->y;
+            break;
+        case INPUT_BUTTONS:
+            c->mouseLDown = (e->x & 1) != 0;
+            c->mouseRDown = (e->x & 2) != 0;
+            c->mDown = (e->x & 4) != 0;
+            c->qDown = (e->x & 8) != 0;
+            break;
+        case INPUT_RAIN:
+            c->raining = e->x;
+            break;
+        case INPUT_PAUSE:
+            c->paused = e->x;
+            break;
+        case INPUT_BRUSH_SIZE:
+            c->brushSize = e->x;
+            if (c->brushSize < 1) c->brushSize = 1;
+            if (c->brushSize > BRUSH_SIZE_MAX) c->brushSize = BRUSH_SIZE_MAX;
+            break;
+        case INPUT_BRUSH_GRAVITY:
+            c->brushGravity = e->x;
+            break;
+        case INPUT_ENGINE:
+            c->engine = e->x == ENGINE_BITPLANES ? ENGINE_BITPLANES : ENGINE_CELLS;
+            break;
+        case INPUT_RESET:
+            c->reset = 1;
+            break;
+        case INPUT_MATERIAL:
+            c->material = e->x > EMPTY && e->x < BLOCK_TYPE_COUNT ? (BlockType) e->x : CONCRETE;
+            break;
+        case INPUT_DISPERSION:
+            c->dispersion = e->x < 1 ? 1 : e->x > MAX_DISPERSION ? MAX_DISPERSION : e->x;
+            break;
+        case INPUT_FALL_SPEED:
+            c->fallSpeed = e->x < 1 ? 1 : e->x > MAX_FALL_SPEED ? MAX_FALL_SPEED : e->x;
+            break;
+        default:
+            break;
+    }
+}
+
+void initInputQueue(InputQueue *q)
+{
+    q->head = 0;
+    q->tail = 0;
+}
+
+int pushInput(InputQueue *q, InputEvent e)
+{
+    unsigned tail = q->tail;
+    if (tail - __atomic_load_n(&q->head, __ATOMIC_ACQUIRE) == INPUT_QUEUE_SIZE) return 0;
+    q->events[tail % INPUT_QUEUE_SIZE] = e;
+    __atomic_store_n(&q->tail, tail + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+int popInput(InputQueue *q, InputEvent *e)
+{
+    unsigned head = q->head;
+    if (head == __atomic_load_n(&q->tail, __ATOMIC_ACQUIRE)) return 0;
+    *e = q->events[head % INPUT_QUEUE_SIZE];
+    __atomic_store_n(&q->head, head + 1, __ATOMIC_RELEASE);
+    return 1;
+}
+
+void paintBrush(World *w, Controls *c)
+{
+    int mx = c->mouseX, my = c->mouseY;
+    if ((!c->mouseLDown && !c->mouseRDown) || mx < 0 || my < 0 || mx >= w->width || my >= w->height)
+    {
+        c->lastPaintX = -1;
+        c->lastPaintY = -1;
+        return;
+    }
+
+    BlockType nt;
+    if (c->mDown) nt = EMPTY;
+    else if (c->mouseLDown && c->qDown) nt = WATER;
+    else if (c->mouseLDown) nt = c->material;
+    else nt = SAND;
+
+    // The cursor can move many cells between frames, stroke from where the brush was last frame
+    int fromX = mx, fromY = my;
+    if (c->lastPaintX >= 0)
+    {
+        fromX = c->lastPaintX;
+        fromY = c->lastPaintY;
+    }
+    stampLine(w, SHAPE_DIAMOND, nt, fromX, fromY, mx, my, c->brushSize - 1, c->brushGravity);
+    c->lastPaintX = mx;
+    c->lastPaintY = my;
+}
+
+// Advances the world by one frame of input: a pending reset, a tick unless paused, the brush and rain
+void runFrame(World *w, Controls *c)
+{
+    if (c->reset)
+    {
+        resetWorld(w);
+        c->reset = 0;
+    }
+    w->engine = c->engine;
+    w->dispersion = c->dispersion;
+    setFallSpeed(w, c->fallSpeed);
+
+    uint64_t start = beginTimer(w->profiler);
+    if (!c->paused)
+    {
+        simulate(w);
+        endTimer(w->profiler, PROFILE_SIMULATE, start);
+    }
+
+    start = beginTimer(w->profiler);
+    paintBrush(w, c);
+    endTimer(w->profiler, PROFILE_BRUSH, start);
+
+    if (c->raining)
+    {
+        start = beginTimer(w->profiler);
+        rain(w);
+        endTimer(w->profiler, PROFILE_RAIN, start);
+    }
+}
@@ -0,0 +1,98 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_INPUT_H
+
+#include "world.h"
+
+#define BRUSH_SIZE_MAX 10
+
+#define INPUT_QUEUE_SIZE 1024
+
+// The values are part of the recording format, only add new ones at the end
+typedef enum InputType_
+{
+    INPUT_END,
+    INPUT_MOUSE,
+    INPUT_BUTTONS,
+    INPUT_RAIN,
+    INPUT_PAUSE,
+    INPUT_BRUSH_SIZE,
+    INPUT_BRUSH_GRAVITY,
+    INPUT_ENGINE,
+    INPUT_RESET,
+    INPUT_MATERIAL,
+    // Requests for the simulation thread, these two are never recorded
+    INPUT_SAVE,
+    INPUT_LOAD,
+    // Recorded like the controls above
+    INPUT_DISPERSION,
+    INPUT_FALL_SPEED
+} InputType;
+
+// A single change to the controls, x holds the new value and y is only used by INPUT_MOUSE
+typedef struct InputEvent_
+{
+    InputType type;
+    int x;
+    int y;
+} InputEvent;
+
+// Lock-free ring of input events with one thread pushing and one thread popping
+typedef struct InputQueue_
+{
+    InputEvent events[INPUT_QUEUE_SIZE];
+    unsigned head;
+    unsigned tail;
+} InputQueue;
+
+// Everything the user can do to the world, as it stands for one frame. The SDL app fills it from
+// events, a replay fills it from a recording.
+typedef struct Controls_
+{
+    // Cell under the cursor, -1 when the cursor is outside the world
+    int mouseX;
+    int mouseY;
+    int mouseLDown;
+    int mouseRDown;
+    int mDown;
+    int qDown;
+    int raining;
+    int paused;
+    int brushSize;
+    int brushGravity;
+    // Placed with the left button
+    BlockType material;
+    Engine engine;
+    int dispersion;
+    int fallSpeed;
+    // Where the brush painted last frame, -1 when it did not
+    int lastPaintX;
+    int lastPaintY;
+    // Set for a single frame
+    int reset;
+} Controls;
+
+void initControls(Controls *c);
+
+// Mouse buttons and held keys packed the way INPUT_BUTTONS carries them
+int getInputButtons(Controls *c);
+
+void applyInput(Controls *c, InputEvent *e);
+
+void initInputQueue(InputQueue *q);
+
+// Returns 0 when the queue is full and the event was dropped
+int pushInput(InputQueue *q, InputEvent e);
+
+// Returns 0 when the queue is empty
+int popInput(InputQueue *q, InputEvent *e);
+
+void paintBrush(World *w, Controls *c);
+
+void runFrame(World *w, Controls *c);
+
+#define PIXSIM_INPUT_H
+
+#endif //PIXSIM_INPUT_H
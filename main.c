@@ -1,4 +1,6 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <SDL.h>
 #include <SDL_ttf.h>
 #include <time.h>
@@ -7,15 +9,15 @@
 #include "vector.h"
 #include "block.h"
 #include "world.h"
-
-#define WIDTH 320
-#define HEIGHT 200
-#define ZOOM 4
-
-#define SIMWIDTH (WIDTH + 2)
-#define SIMHEIGHT (HEIGHT + 1)
-
-void *pixels;
+#include "simulate.h"
+#include "render.h"
+#include "text.h"
+#include "snapshot.h"
+#include "input.h"
+#include "replay.h"
+#include "simthread.h"
+#include "profiler.h"
+#include "capture.h"
 
 double get_secs(void)
 {
@@ -26,191 +28,156 @@ double get_secs(void)
     /*return SDL_GetTicks() / 1000.0;*/
 }
 
-TTF_Font *font;
-
-SDL_Texture *renderText(SDL_Renderer *renderer, char *message, SDL_Color color)
+void uploadFrame(SDL_Texture *texture, Frame *f)
 {
-    //We need to first render to a surface as that's what TTF_RenderText
-    //returns, then load that surface into a texture
-    SDL_Surface *surf = TTF_RenderText_Blended(font, message, color);
-    if (surf == NULL)
+    for (int i = 0; i < f->rectCount; ++i)
     {
-        printf("Could not create surface for text!\n");
-        return NULL;
+        DirtyRect r = f->rects[i];
+        SDL_UpdateTexture(texture, &(SDL_Rect) {r.x, r.y, r.w, r.h}, f->pixels + (size_t) r.y * f->width + r.x,
+                          f->width * (int) sizeof(uint32_t));
     }
-
-    SDL_Texture *text_ure = SDL_CreateTextureFromSurface(renderer, surf);
-    if (text_ure == NULL)
-    {
-        printf("Could not create texture from surface!\n");
-        return NULL;
-    }
-
-    SDL_FreeSurface(surf);
-    return text_ure;
 }
 
-void drawText(SDL_Renderer *renderer, char *message, SDL_Color color, int x, int y)
+// Writes whatever output files were asked for, or both to default names when dumping on request
+void writeProfile(Profiler *p, char *csvPath, char *tracePath, int requested)
 {
-    SDL_Texture *text_ure = renderText(renderer, message, color);
-    int tw, th;
-    if (SDL_QueryTexture(text_ure, NULL, NULL, &tw, &th) != 0)
+    if (requested && csvPath == NULL && tracePath == NULL)
     {
-        printf("Could not query text texture!\n");
+        csvPath = "pixsim-profile.csv";
+        tracePath = "pixsim-trace.json";
     }
-    SDL_RenderCopy(renderer, text_ure, NULL, &(SDL_Rect) {x, y, tw, th});
-    SDL_DestroyTexture(text_ure);
+    if (csvPath != NULL && writeProfileCsv(p, csvPath)) printf("Wrote %s\n", csvPath);
+    if (tracePath != NULL && writeProfileTrace(p, tracePath)) printf("Wrote %s\n", tracePath);
 }
 
-void simulate(World *w)
+void printWorldSize(World *w)
 {
-    //printf("Simulation running..\n");
-    BlockEntry *e = w->blockHeader->next;
-    Block *b;
-    while (e != w->blockTrailer)
-    {
-        b = e->block;
-
-        if (b->gravity)
-        {
-            switch (b->type)
-            {
-                case CONCRETE:
-                {
-                    Block *under;
-                    getBlock(w, b->location.x, b->location.y - 1, &under);
-                    if (under == NULL)
-                    {
-                        moveBlock(w, b, b->location.x, b->location.y - 1);
-                    }
-                }
-                    break;
-                case SAND:
-                {
-                    Block *lu, *l, *u, *r, *ru;
-                    getBlock(w, b->location.x - 1, b->location.y - 1, &lu);
-                    getBlock(w, b->location.x - 1, b->location.y, &l);
-                    getBlock(w, b->location.x, b->location.y - 1, &u);
-                    getBlock(w, b->location.x + 1, b->location.y, &r);
-                    getBlock(w, b->location.x + 1, b->location.y - 1, &ru);
-
-                    if (u == NULL)
-                    {
-                        moveBlock(w, b, b->location.x, b->location.y - 1);
-                    }
-                    else if (u->type == WATER)
-                    {
-                        // Sink underwater
-                        swapBlockLocations(w, b, u);
-
-                        if (l == NULL && r == NULL)
-                        {
-                            int move = u->location.x - 1;
-                            if (rand() % 2) move = u->location.x + 1;
-                            moveBlock(w, u, move, u->location.y);
-                        }
-                        else if (l == NULL) moveBlock(w, u, u->location.x - 1, u->location.y);
-                        else if (r == NULL) moveBlock(w, u, u->location.x + 1, u->location.y);
-                    }
-                    else if (lu == NULL)
-                    {
-                        moveBlock(w, b, b->location.x - 1, b->location.y - 1);
-                    }
-                    else if (ru == NULL)
-                    {
-                        moveBlock(w, b, b->location.x + 1, b->location.y - 1);
-                    }
-                    else if (lu->type == WATER)
-                    {
-                        swapBlockLocations(w, b, lu);
-                    }
-                    else if (ru->type == WATER)
-                    {
-                        swapBlockLocations(w, b, ru);
-                    }
-                }
-                    break;
-                case WATER:
-                {
-                    Block *l, *u, *r;
-                    getBlock(w, b->location.x - 1, b->location.y, &l);
-                    getBlock(w, b->location.x, b->location.y - 1, &u);
-                    getBlock(w, b->location.x + 1, b->location.y, &r);
-
-                    if (u == NULL)
-                    {
-                        moveBlock(w, b, b->location.x, b->location.y - 1);
-                    }
-                    else if (l == NULL && r == NULL)
-                    {
-                        moveBlock(w, b, b->location.x + (((rand() % 2) * 2) - 1), b->location.y);
-                    }
-                    else if (l == NULL)
-                    {
-                        moveBlock(w, b, b->location.x - 1, b->location.y);
-                    }
-                    else if (r == NULL)
-                    {
-                        moveBlock(w, b, b->location.x + 1, b->location.y);
-                    }
-                }
-                    break;
-            }
-        }
-
-        e = e->next;
-    }
-
+    printf("World %dx%d, %zu KiB\n", w->width, w->height, getWorldMemory(w) / 1024);
 }
 
-void draw_pixel(int x, int y, uint8_t r, uint8_t g, uint8_t b, uint8_t a)
+int main(int argc, char **argv)
 {
-    uint8_t *base;
-
-    for (int oy = 0; oy < ZOOM; oy++)
-        for (int ox = 0; ox < ZOOM; ox++)
-        {
-            base = ((uint8_t *) pixels) + (4 * ((y * ZOOM + oy) * WIDTH * ZOOM + (x * ZOOM) + ox));
-            base[0] = r;
-            base[1] = g;
-            base[2] = b;
-            base[3] = a;
-        }
-}
-
-void draw_pixel_c(int x, int y, Color c)
-{
-    draw_pixel(x, y, c.r, c.g, c.b, 255);
-}
-
-void render(World *w)
-{
-    BlockEntry *e = w->blockHeader->next;
-    Block *b;
-    while (e != w->blockTrailer)
+    int width = 320;
+    int height = 200;
+    int zoom = 4;
+    uint64_t seed = (uint64_t) time(NULL);
+    int threads = getCpuCount();
+    Engine engine = ENGINE_CELLS;
+    char *snapshotPath = "pixsim.pxs";
+    char *loadPath = NULL;
+    char *recordPath = NULL;
+    char *replayPath = NULL;
+    int pageAfter = 0;
+    char *pagePath = NULL;
+    int tickRate = 60;
+    int dispersion = 1;
+    int fallSpeed = 1;
+    int turbo = 0;
+    char *capturePath = NULL;
+    int captureEvery = 1;
+    char *profileCsvPath = NULL;
+    char *tracePath = NULL;
+    for (int i = 1; i < argc; ++i)
     {
-        b = e->block;
-        if (b->location.x >= 0 && b->location.x < WIDTH && b->location.y >= 0 && b->location.y < HEIGHT)
+        if (i + 1 < argc && strcmp(argv[i], "--width") == 0) width = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--height") == 0) height = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--zoom") == 0) zoom = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--seed") == 0) seed = strtoull(argv[++i], NULL, 10);
+        else if (i + 1 < argc && strcmp(argv[i], "--threads") == 0) threads = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--engine") == 0)
+            engine = strcmp(argv[++i], "bitplanes") == 0 ? ENGINE_BITPLANES : ENGINE_CELLS;
+        else if (i + 1 < argc && strcmp(argv[i], "--snapshot") == 0) snapshotPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--load") == 0) snapshotPath = loadPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--record") == 0) recordPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--replay") == 0) replayPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--page") == 0) pageAfter = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--page-file") == 0) pagePath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--tick-rate") == 0) tickRate = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--dispersion") == 0) dispersion = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--fall-speed") == 0) fallSpeed = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--capture") == 0) capturePath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--capture-every") == 0) captureEvery = atoi(argv[++i]);
+        else if (i + 1 < argc && strcmp(argv[i], "--turbo") == 0)
         {
-            draw_pixel_c(b->location.x, HEIGHT - b->location.y - 1, b->color);
+            ++i;
+            turbo = strcmp(argv[i], "max") == 0 ? TURBO_MAX : atoi(argv[i]);
         }
-        e = e->next;
+        else if (i + 1 < argc && strcmp(argv[i], "--profile-csv") == 0) profileCsvPath = argv[++i];
+        else if (i + 1 < argc && strcmp(argv[i], "--trace") == 0) tracePath = argv[++i];
+    }
+    if (width <= 0 || height <= 0 || zoom <= 0 || tickRate <= 0 || captureEvery <= 0)
+    {
+        printf("World size, zoom, tick rate and capture interval have to be positive!\n");
+        return 1;
+    }
+    if (turbo < 0 && turbo != TURBO_MAX)
+    {
+        printf("Turbo has to be a number of ticks per frame or max!\n");
+        return 1;
+    }
+    if (dispersion < 1 || dispersion > MAX_DISPERSION)
+    {
+        printf("Dispersion has to be between 1 and %d!\n", MAX_DISPERSION);
+        return 1;
+    }
+    if (fallSpeed < 1 || fallSpeed > MAX_FALL_SPEED)
+    {
+        printf("Fall speed has to be between 1 and %d!\n", MAX_FALL_SPEED);
+        return 1;
     }
-}
-
-
 
-int main()
-{
-    srand((unsigned) time(NULL));
+    // A replay brings its own world size and seed and overrides the command line
+    Replay *replay = NULL;
+    if (replayPath != NULL)
+    {
+        if (!createReplay(&replay, replayPath)) return 1;
+        width = replay->width;
+        height = replay->height;
+        seed = replay->seed;
+        loadPath = NULL;
+    }
+    printf("Seed: %llu\n", (unsigned long long) seed);
 
-    World *w;
-    createWorld(&w, WIDTH, HEIGHT);
+    ThreadPool *workers;
+    createThreadPool(&workers, threads);
 
-    Block *b;
+    // A snapshot loaded at startup decides the world size as well
+    World *w = NULL;
+    if (loadPath != NULL)
+    {
+        if (recordPath != NULL) printf("Recordings start from an empty world, not loading %s!\n", loadPath);
+        else if (loadWorld(&w, loadPath)) printf("Loaded %s at tick %llu\n", loadPath, (unsigned long long) w->tick);
+    }
+    if (w == NULL)
+    {
+        createWorld(&w, width, height);
+        seedWorld(w, seed);
+    }
+    width = w->width;
+    height = w->height;
+    Profiler *profiler;
+    createProfiler(&profiler);
+    w->workers = workers;
+    w->profiler = profiler;
+    w->engine = engine;
+    if (pageAfter > 0 && !setChunkPaging(w, pageAfter, pagePath)) return 1;
+    printWorldSize(w);
+
+    Recorder *recorder = NULL;
+    if (recordPath != NULL) createRecorder(&recorder, recordPath, w);
+
+    // The window is never held up by the disk, frames the writer can not keep up with are dropped
+    Capture *capture = NULL;
+    if (capturePath != NULL)
+    {
+        int fps = tickRate / captureEvery;
+        if (!createCapture(&capture, capturePath, getCaptureFormat(capturePath), width, height, fps > 0 ? fps : 1))
+            return 1;
+        capture->every = captureEvery;
+        capture->dropWhenFull = 1;
+    }
 
-    //addBlock(&b, SAND, 0, 180);
-    //b->color = (Color) {255, 255, 255};
+    //addBlock(w, SAND, 0, 180, 1, (Color) {255, 255, 255});
 
     SDL_Window *window;
     SDL_Renderer *renderer;
@@ -218,201 +185,238 @@ int main()
     SDL_Init(SDL_INIT_EVERYTHING);
     TTF_Init();
 
-    font = TTF_OpenFont("../assets/Arial.ttf", 16);
+    TTF_Font *font = TTF_OpenFont("../assets/Arial.ttf", 16);
     if (font == NULL)
     {
         printf("Could not open font!\n");
         return 1;
     }
 
-    SDL_CreateWindowAndRenderer(WIDTH * ZOOM, HEIGHT * ZOOM, 0, &window, &renderer);
+    // Large worlds get shrunk to fit on the screen, SDL_RenderCopy scales either way
+    int windowWidth = width * zoom, windowHeight = height * zoom;
+    SDL_DisplayMode display;
+    if (SDL_GetDesktopDisplayMode(0, &display) == 0 && (windowWidth > display.w || windowHeight > display.h))
+    {
+        double scale = fmin(display.w * 0.9 / width, display.h * 0.9 / height);
+        windowWidth = (int) (width * scale);
+        windowHeight = (int) (height * scale);
+        if (windowWidth < 1) windowWidth = 1;
+        if (windowHeight < 1) windowHeight = 1;
+    }
+    SDL_CreateWindowAndRenderer(windowWidth, windowHeight, 0, &window, &renderer);
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo(renderer, &info) == 0 && info.max_texture_width > 0 &&
+        (width > info.max_texture_width || height > info.max_texture_height))
+    {
+        printf("A %dx%d world does not fit in a %dx%d texture, use pixsim_bench for larger worlds!\n", width,
+               height, info.max_texture_width, info.max_texture_height);
+        return 1;
+    }
+    // The HUD strings rarely change, the FPS counter and the profiler overlay do and those are put
+    // together from glyphs
+    TextCache *text;
+    createTextCache(&text, renderer, font, 32);
+    char printable[96];
+    for (int i = 0; i < 95; ++i) printable[i] = (char) (' ' + i);
+    printable[95] = '\0';
+    GlyphAtlas *glyphs;
+    createGlyphAtlas(&glyphs, renderer, font, printable);
+    // One texel per cell, SDL_RenderCopy takes care of scaling it up to the window
     SDL_Texture *texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ABGR8888, SDL_TEXTUREACCESS_STREAMING,
-                                             WIDTH * ZOOM, HEIGHT * ZOOM);
+                                             width, height);
+
+    Controls controls;
+    initControls(&controls);
+    if (replay == NULL)
+    {
+        controls.engine = engine;
+        controls.dispersion = dispersion;
+        controls.fallSpeed = fallSpeed;
+    }
+
+    // From here on the world belongs to the simulation thread, this thread only shows what it publishes
+    SimThread *sim;
+    createSimThread(&sim, w, &controls, tickRate);
+    sim->recorder = recorder;
+    sim->replay = replay;
+    sim->capture = capture;
+    sim->snapshotPath = snapshotPath;
+    sim->pageAfter = pageAfter;
+    sim->pagePath = pagePath;
+    sim->turbo = turbo;
+    startSimThread(sim);
 
     double oldTime = 0;
     double timeNow = 0;
     struct timespec startTime, endTime;
 
-    int pitch;
     SDL_Event event;
+    int mouseX = -1, mouseY = -1;
 
-    int mouseLDown = 0;
-    int mouseRDown = 0;
-    int mDown = 0;
-    int qDown = 0;
-    int raining = 0;
-    int simulationPaused = 0;
-    int brushSize = 1;
-    int brushGravity = 1;
+    // Sorting the samples every frame would show up in the HUD timings, so the overlay is refreshed a
+    // few times per second
+    int showProfile = 0;
+    double profileUpdated = 0;
+    PhaseStats phaseStats[PROFILE_PHASE_COUNT];
+    memset(phaseStats, 0, sizeof(phaseStats));
 
     while (1)
     {
         clock_gettime(CLOCK_MONOTONIC_RAW, &startTime);
 
-        SDL_LockTexture(texture, NULL, &pixels, &pitch);
+        SimStatus status;
+        getSimStatus(sim, &status);
+        if (status.finished) break;
 
-        if (!simulationPaused) simulate(w);
-        if (mouseLDown || mouseRDown)
+        if (replay == NULL)
         {
             int mx, my;
             SDL_GetMouseState(&mx, &my);
-            mx /= ZOOM;
-            my /= ZOOM;
-            my = HEIGHT - 1 - my;
-            if (mx >= 0 && my >= 0 && mx < WIDTH && my < HEIGHT)
+            mx = (int) ((long long) mx * width / windowWidth);
+            my = height - 1 - (int) ((long long) my * height / windowHeight);
+            int inside = mx >= 0 && my >= 0 && mx < width && my < height;
+            if (!inside) mx = my = -1;
+            if (mx != mouseX || my != mouseY)
             {
-                //printf("Spawn %d %d\n", mx, my);
-                getBlock(w, mx, my, &b);
-                //printf("%d\n", b != NULL);
-
-                if (b != NULL)
-                {
-                    deleteBlock(w, b);
-                }
-
-                Color nc;
-                BlockType nt;
-                if (mouseLDown && qDown)
-                {
-                    nc = (Color) {0, 0, 255};
-                    nt = WATER;
-                }
-                else if (mouseLDown)
-                {
-                    nc = (Color) {255, 0, 0};
-                    nt = CONCRETE;
-                }
-                else
-                {
-                    nc = (Color) {0, 255, 0};
-                    nt = SAND;
-                }
-
-                PairInt brushBlocks[brushSize * brushSize * 4];
-                int brushc = 0;
-                brushBlocks[brushc++] = (PairInt) {0, 0};
-                for (int i = 1; i < brushSize; i++)
-                {
-                    brushBlocks[brushc++] = (PairInt) {-i, 0};
-                    brushBlocks[brushc++] = (PairInt) {i, 0};
-                }
-                for (int j = 1; j < brushSize; j++)
-                {
-                    brushBlocks[brushc++] = (PairInt) {0, j};
-                    brushBlocks[brushc++] = (PairInt) {0, -j};
-                    for (int i = 1; i < brushSize - j; ++i)
-                    {
-                        brushBlocks[brushc++] = (PairInt) {-i, j};
-                        brushBlocks[brushc++] = (PairInt) {i, j};
-                        brushBlocks[brushc++] = (PairInt) {-i, -j};
-                        brushBlocks[brushc++] = (PairInt) {i, -j};
-                    }
-                }
-
-                for (int i = 0; i < brushc; ++i)
-                {
-                    PairInt l = brushBlocks[i];
-                    int lx = l.x, ly = l.y;
-                    int bx = mx + lx, by = my + ly;
-                    if (bx >= 0 && by >= 0 && bx < WIDTH && by < HEIGHT)
-                    {
-                        if (mDown)
-                        {
-                            getBlock(w, bx, by, &b);
-                            if (b != NULL) deleteBlock(w, b);
-                        }
-                        else
-                        {
-                            addBlock(w, &b, nt, bx, by);
-                            b->color = (Color) {nc.r, nc.g, nc.b};
-                            b->gravity = brushGravity;
-                        }
-                    }
-                }
+                mouseX = mx;
+                mouseY = my;
+                sendInput(sim, (InputEvent) {INPUT_MOUSE, mx, my});
             }
         }
-        if (raining)
-        {
-            int x1, x2;
-            Block *bw1, *bw2;
-
-            x1 = rand() % WIDTH;
-            do
-            {
-                x2 = rand() % WIDTH;
-            } while (x2 == x1);
-
-            addBlock(w, &bw1, WATER, x1, HEIGHT - 1);
-            addBlock(w, &bw2, WATER, x2, HEIGHT - 1);
-            bw1->color = (Color) {0, 0, 255};
-            bw2->color = (Color) {0, 0, 255};
-        }
-        render(w);
 
-        SDL_UnlockTexture(texture);
+        uint64_t phaseStart = beginTimer(profiler);
+        Frame *frame = acquireFrame(sim->frames);
+        if (frame != NULL) uploadFrame(texture, frame);
         SDL_RenderCopy(renderer, texture, NULL, NULL);
+        endTimer(profiler, PROFILE_UPLOAD, phaseStart);
 
+        phaseStart = beginTimer(profiler);
         oldTime = timeNow;
         timeNow = get_secs();
         double frameTime = timeNow - oldTime; //frameTime is the timeNow this frame has taken, in seconds
-        printf("FPS = %f\n", 1 / frameTime);
 
         char fpsText[10];
         sprintf(fpsText, "%d FPS", (int) round(1 / frameTime));
-        drawText(renderer, fpsText, (SDL_Color) {255, 255, 255, 255}, 10, 10);
+        drawGlyphText(glyphs, fpsText, (SDL_Color) {255, 255, 255, 255}, 10, 10);
 
         char brushSizeText[15];
-        sprintf(brushSizeText, "Brush size: %d", brushSize);
-        drawText(renderer, brushSizeText, (SDL_Color) {255, 255, 255, 255}, 10, 30);
+        sprintf(brushSizeText, "Brush size: %d", status.controls.brushSize);
+        drawText(text, brushSizeText, (SDL_Color) {255, 255, 255, 255}, 10, 30);
 
         char brushGravityText[25];
-        sprintf(brushGravityText, "Brush gravity: %s", brushGravity ? "enabled" : "disabled");
-        drawText(renderer, brushGravityText, (SDL_Color) {255, 255, 255, 255}, 10, 50);
+        sprintf(brushGravityText, "Brush gravity: %s", status.controls.brushGravity ? "enabled" : "disabled");
+        drawText(text, brushGravityText, (SDL_Color) {255, 255, 255, 255}, 10, 50);
+
+        char materialText[32];
+        sprintf(materialText, "Material: %s", materials[status.controls.material].name);
+        drawText(text, materialText, (SDL_Color) {255, 255, 255, 255}, 10, 70);
+
+        char dispersionText[24];
+        sprintf(dispersionText, "Dispersion: %d", status.controls.dispersion);
+        drawText(text, dispersionText, (SDL_Color) {255, 255, 255, 255}, 10, 90);
+
+        char fallSpeedText[24];
+        sprintf(fallSpeedText, "Fall speed: %d", status.controls.fallSpeed);
+        drawText(text, fallSpeedText, (SDL_Color) {255, 255, 255, 255}, 10, 110);
+
+        char speedText[48];
+        if (status.turbo == TURBO_MAX) sprintf(speedText, "%.0f ticks/s, turbo max", status.ticksPerSecond);
+        else if (status.turbo > 0) sprintf(speedText, "%.0f ticks/s, turbo x%d", status.ticksPerSecond, status.turbo);
+        else sprintf(speedText, "%.0f ticks/s", status.ticksPerSecond);
+        if (status.stats.settled) strcat(speedText, ", settled");
+        drawGlyphText(glyphs, speedText, (SDL_Color) {255, 255, 255, 255}, 10, 130);
+
+        // Census of the materials in the world and what the last tick did
+        char censusText[192];
+        int length = 0;
+        for (int t = 1; t < BLOCK_TYPE_COUNT; ++t)
+        {
+            if (status.stats.cells[t] == 0) continue;
+            length += sprintf(censusText + length, "%s%s %llu", length > 0 ? ", " : "", materials[t].name,
+                              (unsigned long long) status.stats.cells[t]);
+        }
+        if (length == 0) strcpy(censusText, "Empty");
+        drawGlyphText(glyphs, censusText, (SDL_Color) {255, 255, 255, 255}, 10, 150);
 
-        if (simulationPaused)
+        char activityText[96];
+        sprintf(activityText, "%llu moved, %llu blocks in %d awake chunks", (unsigned long long) status.stats.moved,
+                (unsigned long long) status.stats.activeBlocks, status.stats.awakeChunks);
+        drawGlyphText(glyphs, activityText, (SDL_Color) {255, 255, 255, 255}, 10, 170);
+
+        if (status.controls.paused)
         {
             char simulationPausedText[] = "Simulation Paused";
-            SDL_Texture *sp_texture = renderText(renderer, simulationPausedText, (SDL_Color) {255, 255, 255, 255});
             int tw, th;
-            if (SDL_QueryTexture(sp_texture, NULL, NULL, &tw, &th) != 0)
+            SDL_Texture *sp_texture = getTextTexture(text, simulationPausedText, (SDL_Color) {255, 255, 255, 255},
+                                                     &tw, &th);
+            SDL_RenderCopy(renderer, sp_texture, NULL, &(SDL_Rect) {windowWidth - 1 - 10 - tw, 10, tw, th});
+        }
+
+        if (showProfile)
+        {
+            if (timeNow - profileUpdated >= 0.25)
             {
-                printf("Could not query text texture!\n");
+                for (int p = 0; p < PROFILE_PHASE_COUNT; ++p) getPhaseStats(profiler, p, 256, &phaseStats[p]);
+                profileUpdated = timeNow;
+            }
+            SDL_Color color = {255, 255, 160, 255};
+            char *headers[] = {"ms", "p50", "p95", "p99", "min", "max"};
+            for (int col = 0; col < 6; ++col) drawGlyphText(glyphs, headers[col], color, 10 + col * 60, 200);
+            for (int p = 0; p < PROFILE_PHASE_COUNT; ++p)
+            {
+                PhaseStats *ps = &phaseStats[p];
+                double values[] = {ps->p50, ps->p95, ps->p99, ps->min, ps->max};
+                int y = 200 + (p + 1) * glyphs->height;
+                drawGlyphText(glyphs, (char *) profilePhaseNames[p], color, 10, y);
+                for (int col = 0; col < 5; ++col)
+                {
+                    char value[16];
+                    sprintf(value, "%.2f", values[col]);
+                    drawGlyphText(glyphs, value, color, 70 + col * 60, y);
+                }
             }
-            SDL_RenderCopy(renderer, sp_texture, NULL, &(SDL_Rect) {(WIDTH * ZOOM) - 1 - 10 - tw, 10, tw, th});
-            SDL_DestroyTexture(sp_texture);
         }
+        endTimer(profiler, PROFILE_HUD, phaseStart);
 
+        phaseStart = beginTimer(profiler);
         SDL_RenderPresent(renderer);
+        endTimer(profiler, PROFILE_PRESENT, phaseStart);
 
         int quit = 0;
         while (SDL_PollEvent(&event))
         {
+            // While replaying only quitting and the speed are up to the user
+            if (replay != NULL && event.type != SDL_QUIT &&
+                !(event.type == SDL_KEYUP && event.key.keysym.sym == SDLK_f))
+                continue;
+            int buttons = getInputButtons(&controls);
             switch (event.type)
             {
                 case SDL_QUIT:
                     quit = 1;
                     break;
                 case SDL_MOUSEBUTTONDOWN:
-                    if (event.button.button == SDL_BUTTON_LEFT) mouseLDown = 1;
-                    if (event.button.button == SDL_BUTTON_RIGHT) mouseRDown = 1;
+                    if (event.button.button == SDL_BUTTON_LEFT) controls.mouseLDown = 1;
+                    if (event.button.button == SDL_BUTTON_RIGHT) controls.mouseRDown = 1;
                     break;
                 case SDL_MOUSEBUTTONUP:
-                    if (event.button.button == SDL_BUTTON_LEFT) mouseLDown = 0;
-                    if (event.button.button == SDL_BUTTON_RIGHT) mouseRDown = 0;
+                    if (event.button.button == SDL_BUTTON_LEFT) controls.mouseLDown = 0;
+                    if (event.button.button == SDL_BUTTON_RIGHT) controls.mouseRDown = 0;
                     break;
                 case SDL_MOUSEWHEEL:
-                    brushSize += (event.wheel.y / 3);
-                    if (brushSize > 10) brushSize = 10;
-                    if (brushSize < 1) brushSize = 1;
+                    controls.brushSize += (event.wheel.y / 3);
+                    if (controls.brushSize > BRUSH_SIZE_MAX) controls.brushSize = BRUSH_SIZE_MAX;
+                    if (controls.brushSize < 1) controls.brushSize = 1;
+                    sendInput(sim, (InputEvent) {INPUT_BRUSH_SIZE, controls.brushSize, 0});
                     break;
                 case SDL_KEYDOWN:
                     switch (event.key.keysym.sym)
                     {
                         case SDLK_m:
-                            mDown = 1;
+                            controls.mDown = 1;
                             break;
                         case SDLK_q:
-                            qDown = 1;
+                            controls.qDown = 1;
                             break;
                         default:
                             break;
@@ -422,22 +426,75 @@ int main()
                     switch (event.key.keysym.sym)
                     {
                         case SDLK_a:
-                            raining = !raining;
+                            controls.raining = !controls.raining;
+                            sendInput(sim, (InputEvent) {INPUT_RAIN, controls.raining, 0});
                             break;
                         case SDLK_r:
-                            resetWorld(w);
+                            sendInput(sim, (InputEvent) {INPUT_RESET, 0, 0});
+                            break;
+                        case SDLK_s:
+                            sendInput(sim, (InputEvent) {INPUT_SAVE, 0, 0});
+                            break;
+                        case SDLK_l:
+                            sendInput(sim, (InputEvent) {INPUT_LOAD, 0, 0});
                             break;
                         case SDLK_p:
-                            simulationPaused = !simulationPaused;
+                            controls.paused = !controls.paused;
+                            sendInput(sim, (InputEvent) {INPUT_PAUSE, controls.paused, 0});
                             break;
                         case SDLK_g:
-                            brushGravity = !brushGravity;
+                            controls.brushGravity = !controls.brushGravity;
+                            sendInput(sim, (InputEvent) {INPUT_BRUSH_GRAVITY, controls.brushGravity, 0});
+                            break;
+                        case SDLK_e:
+                            controls.engine = controls.engine == ENGINE_CELLS ? ENGINE_BITPLANES : ENGINE_CELLS;
+                            sendInput(sim, (InputEvent) {INPUT_ENGINE, controls.engine, 0});
+                            printf("Engine: %s\n", controls.engine == ENGINE_CELLS ? "cells" : "bitplanes");
+                            break;
+                        case SDLK_1:
+                        case SDLK_2:
+                        case SDLK_3:
+                        case SDLK_4:
+                        case SDLK_5:
+                        case SDLK_6:
+                            // The number keys follow the order of the block types, 1 is concrete
+                            if (event.key.keysym.sym - SDLK_0 < BLOCK_TYPE_COUNT)
+                            {
+                                controls.material = (BlockType) (event.key.keysym.sym - SDLK_0);
+                                sendInput(sim, (InputEvent) {INPUT_MATERIAL, controls.material, 0});
+                            }
+                            break;
+                        case SDLK_d:
+                            // 1, 4, 16 and the most there is
+                            controls.dispersion = controls.dispersion >= MAX_DISPERSION ? 1 :
+                                                  controls.dispersion * 4 > MAX_DISPERSION ? MAX_DISPERSION :
+                                                  controls.dispersion * 4;
+                            sendInput(sim, (InputEvent) {INPUT_DISPERSION, controls.dispersion, 0});
+                            break;
+                        case SDLK_v:
+                            // 1, 4 and the fastest there is
+                            controls.fallSpeed = controls.fallSpeed >= MAX_FALL_SPEED ? 1 :
+                                                 controls.fallSpeed * 4 > MAX_FALL_SPEED ? MAX_FALL_SPEED :
+                                                 controls.fallSpeed * 4;
+                            sendInput(sim, (InputEvent) {INPUT_FALL_SPEED, controls.fallSpeed, 0});
+                            break;
+                        case SDLK_f:
+                            // Off, 4 and 16 ticks per frame, then as many as fit
+                            turbo = turbo == 0 ? 4 : turbo == 4 ? 16 : turbo == 16 ? TURBO_MAX : 0;
+                            setSimTurbo(sim, turbo);
+                            break;
+                        case SDLK_o:
+                            showProfile = !showProfile;
+                            profileUpdated = 0;
+                            break;
+                        case SDLK_t:
+                            writeProfile(profiler, profileCsvPath, tracePath, 1);
                             break;
                         case SDLK_m:
-                            mDown = 0;
+                            controls.mDown = 0;
                             break;
                         case SDLK_q:
-                            qDown = 0;
+                            controls.qDown = 0;
                             break;
                         default:
                             break;
@@ -446,6 +503,10 @@ int main()
                 default:
                     break;
             }
+            if (getInputButtons(&controls) != buttons)
+            {
+                sendInput(sim, (InputEvent) {INPUT_BUTTONS, getInputButtons(&controls), 0});
+            }
             if (quit) break;
         }
         if (quit) break;
@@ -461,6 +522,26 @@ int main()
         nanosleep(&req, &rem);
     }
 
+    stopSimThread(sim);
+    w = sim->world;
+    destroySimThread(sim);
+    if (recorder != NULL) destroyRecorder(recorder);
+    if (replay != NULL) destroyReplay(replay);
+    if (capture != NULL)
+    {
+        uint64_t dropped = capture->dropped;
+        destroyCapture(capture);
+        printf("Captured to %s, %llu frames dropped\n", capturePath, (unsigned long long) dropped);
+    }
+    writeProfile(profiler, profileCsvPath, tracePath, 0);
+    destroyGlyphAtlas(glyphs);
+    destroyTextCache(text);
+    TTF_CloseFont(font);
+    destroyWorld(w);
+    destroyProfiler(profiler);
+    destroyThreadPool(workers);
+
+    SDL_DestroyTexture(texture);
     SDL_DestroyRenderer(renderer);
     SDL_DestroyWindow(window);
     SDL_Quit();
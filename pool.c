@@ -0,0 +1,173 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pool.h"
+
+
+void createPool(Pool **p, size_t itemSize, int itemsPerSlab)
+{
+    Pool *np;
+    np = malloc(sizeof(Pool));
+
+    // Freed items hold the free list link, so they need room for a pointer
+    if (itemSize < sizeof(void *)) itemSize = sizeof(void *);
+    np->itemSize = (itemSize + sizeof(void *) - 1) / sizeof(void *) * sizeof(void *);
+    np->itemsPerSlab = itemsPerSlab;
+    np->slabs = NULL;
+    np->slabCount = 0;
+    np->slabCapacity = 0;
+    np->currentSlab = 0;
+    np->slabUsed = 0;
+    np->freeList = NULL;
+    np->live = 0;
+    np->highWater = 0;
+
+    *p = np;
+}
+
+void *poolAlloc(Pool *p)
+{
+    void *item;
+    if (p->freeList != NULL)
+    {
+        item = p->freeList;
+        p->freeList = *(void **) item;
+    }
+    else
+    {
+        if (p->slabCount == 0 || p->slabUsed == p->itemsPerSlab)
+        {
+            if (p->slabCount > 0) p->currentSlab++;
+            p->slabUsed = 0;
+        }
+        if (p->currentSlab == p->slabCount)
+        {
+            if (p->slabCount == p->slabCapacity)
+            {
+                p->slabCapacity = p->slabCapacity ? p->slabCapacity * 2 : 8;
+                p->slabs = realloc(p->slabs, p->slabCapacity * sizeof(char *));
+                if (p->slabs == NULL)
+                {
+                    printf("Could not grow pool slab table!\n");
+                    exit(1);
+                }
+            }
+            p->slabs[p->slabCount] = malloc(p->itemSize * p->itemsPerSlab);
+            if (p->slabs[p->slabCount] == NULL)
+            {
+                printf("Could not allocate pool slab!\n");
+                exit(1);
+            }
+            p->slabCount++;
+        }
+        item = p->slabs[p->currentSlab] + p->itemSize * p->slabUsed++;
+    }
+
+    p->live++;
+    if (p->live > p->highWater) p->highWater = p->live;
+    return item;
+}
+
+void poolFree(Pool *p, void *item)
+{
+    *(void **) item = p->freeList;
+    p->freeList = item;
+    p->live--;
+}
+
+void resetPool(Pool *p)
+{
+    p->currentSlab = 0;
+    p->slabUsed = 0;
+    p->freeList = NULL;
+    p->live = 0;
+}
+
+typedef struct SlabRange_
+{
+    char *start;
+    int index;
+} SlabRange;
+
+static int compareSlabRanges(const void *a, const void *b)
+{
+    char *x = ((const SlabRange *) a)->start, *y = ((const SlabRange *) b)->start;
+    return x < y ? -1 : x > y;
+}
+
+static int findSlab(Pool *p, SlabRange *ranges, char *item)
+{
+    int low = 0, high = p->slabCount - 1;
+    while (low < high)
+    {
+        int mid = (low + high + 1) / 2;
+        if (ranges[mid].start <= item) low = mid;
+        else high = mid - 1;
+    }
+    return ranges[low].index;
+}
+
+void trimPool(Pool *p)
+{
+    // Slabs past the one being carved up are only there after a reset and hold nothing
+    int spare = p->slabCount - p->currentSlab - 1;
+    int carved = p->currentSlab * p->itemsPerSlab + p->slabUsed;
+    if (p->slabCount == 0 || (spare == 0 && carved - p->live < p->itemsPerSlab)) return;
+
+    SlabRange *ranges = malloc(p->slabCount * sizeof(SlabRange));
+    int *freeItems = calloc(p->slabCount, sizeof(int));
+    if (ranges == NULL || freeItems == NULL)
+    {
+        printf("Could not allocate pool trim tables!\n");
+        exit(1);
+    }
+    for (int i = 0; i < p->slabCount; ++i) ranges[i] = (SlabRange) {p->slabs[i], i};
+    qsort(ranges, p->slabCount, sizeof(SlabRange), compareSlabRanges);
+
+    for (void *item = p->freeList; item != NULL; item = *(void **) item) freeItems[findSlab(p, ranges, item)]++;
+
+    // The current slab stays, it is where the next items come from
+    for (int i = 0; i < p->slabCount; ++i)
+    {
+        if (i > p->currentSlab || (i < p->currentSlab && freeItems[i] == p->itemsPerSlab)) freeItems[i] = -1;
+    }
+
+    void **link = &p->freeList;
+    while (*link != NULL)
+    {
+        if (freeItems[findSlab(p, ranges, *link)] < 0) *link = *(void **) *link;
+        else link = (void **) *link;
+    }
+
+    int kept = 0, current = 0;
+    for (int i = 0; i < p->slabCount; ++i)
+    {
+        if (i == p->currentSlab) current = kept;
+        if (freeItems[i] < 0) free(p->slabs[i]);
+        else p->slabs[kept++] = p->slabs[i];
+    }
+    p->slabCount = kept;
+    p->currentSlab = current;
+
+    free(ranges);
+    free(freeItems);
+}
+
+void getPoolStats(Pool *p, PoolStats *s)
+{
+    s->live = p->live;
+    s->highWater = p->highWater;
+    s->slabs = p->slabCount;
+    s->bytes = p->itemSize * p->itemsPerSlab * p->slabCount;
+}
+
+void destroyPool(Pool *p)
+{
+    for (int i = 0; i < p->slabCount; ++i) free(p->slabs[i]);
+    free(p->slabs);
+    free(p);
+}
@@ -0,0 +1,50 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_POOL_H
+
+#include <stddef.h>
+
+typedef struct PoolStats_
+{
+    int live;       // items currently handed out
+    int highWater;  // most items ever handed out at once
+    int slabs;      // contiguous slabs of backing memory
+    size_t bytes;   // bytes reserved by the slabs
+} PoolStats;
+
+// Fixed-size object pool. Items are carved out of large slabs and recycled through a free list,
+// releasing everything at once only rewinds the pool so the slabs are reused afterwards.
+typedef struct Pool_
+{
+    size_t itemSize;
+    int itemsPerSlab;
+    char **slabs;
+    int slabCount;
+    int slabCapacity;
+    int currentSlab;
+    int slabUsed;
+    void *freeList;
+    int live;
+    int highWater;
+} Pool;
+
+void createPool(Pool **p, size_t itemSize, int itemsPerSlab);
+
+void *poolAlloc(Pool *p);
+
+void poolFree(Pool *p, void *item);
+
+void resetPool(Pool *p);
+
+// Hands slabs whose items are all free back to the system
+void trimPool(Pool *p);
+
+void getPoolStats(Pool *p, PoolStats *s);
+
+void destroyPool(Pool *p);
+
+#define PIXSIM_POOL_H
+
+#endif //PIXSIM_POOL_H
@@ -0,0 +1,141 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "profiler.h"
+
+const char *profilePhaseNames[PROFILE_PHASE_COUNT] = {
+        "simulate", "brush", "rain", "render", "publish", "upload", "hud", "present"
+};
+
+// Small per thread ids for the trace, handed out the first time a thread records a sample
+static uint32_t nextThreadId = 1;
+static __thread uint32_t profileThreadId = 0;
+
+uint64_t getProfileTime(void)
+{
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (uint64_t) t.tv_sec * 1000000000ULL + (uint64_t) t.tv_nsec;
+}
+
+void createProfiler(Profiler **p)
+{
+    Profiler *np;
+    np = malloc(sizeof(Profiler));
+    if (np == NULL)
+    {
+        printf("Could not allocate profiler!\n");
+        exit(1);
+    }
+    np->origin = getProfileTime();
+    memset(np->count, 0, sizeof(np->count));
+    pthread_mutex_init(&np->lock, NULL);
+    *p = np;
+}
+
+void endTimer(Profiler *p, ProfilePhase phase, uint64_t start)
+{
+    if (p == NULL) return;
+    uint64_t end = getProfileTime();
+    if (profileThreadId == 0) profileThreadId = __atomic_fetch_add(&nextThreadId, 1, __ATOMIC_RELAXED);
+
+    pthread_mutex_lock(&p->lock);
+    ProfileSample *s = &p->samples[phase][p->count[phase] % PROFILE_SAMPLES];
+    s->start = start - p->origin;
+    s->duration = end - start > UINT32_MAX ? UINT32_MAX : (uint32_t) (end - start);
+    s->thread = profileThreadId;
+    p->count[phase]++;
+    pthread_mutex_unlock(&p->lock);
+}
+
+static int compareDurations(const void *a, const void *b)
+{
+    uint32_t x = *(const uint32_t *) a, y = *(const uint32_t *) b;
+    return (x > y) - (x < y);
+}
+
+void getPhaseStats(Profiler *p, ProfilePhase phase, int window, PhaseStats *s)
+{
+    static __thread uint32_t durations[PROFILE_SAMPLES];
+    memset(s, 0, sizeof(PhaseStats));
+
+    pthread_mutex_lock(&p->lock);
+    uint64_t count = p->count[phase];
+    int n = count < PROFILE_SAMPLES ? (int) count : PROFILE_SAMPLES;
+    if (window > 0 && window < n) n = window;
+    for (int i = 0; i < n; ++i) durations[i] = p->samples[phase][(count - n + i) % PROFILE_SAMPLES].duration;
+    pthread_mutex_unlock(&p->lock);
+
+    if (n == 0) return;
+    qsort(durations, n, sizeof(uint32_t), compareDurations);
+    double total = 0;
+    for (int i = 0; i < n; ++i) total += durations[i];
+
+    s->count = n;
+    s->min = durations[0] * 1e-6;
+    s->max = durations[n - 1] * 1e-6;
+    s->mean = total / n * 1e-6;
+    s->p50 = durations[(n - 1) * 50 / 100] * 1e-6;
+    s->p95 = durations[(n - 1) * 95 / 100] * 1e-6;
+    s->p99 = durations[(n - 1) * 99 / 100] * 1e-6;
+}
+
+int writeProfileCsv(Profiler *p, char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        printf("Could not write profile %s!\n", path);
+        return 0;
+    }
+    fprintf(file, "phase,samples,min_ms,p50_ms,p95_ms,p99_ms,max_ms,mean_ms\n");
+    for (int phase = 0; phase < PROFILE_PHASE_COUNT; ++phase)
+    {
+        PhaseStats s;
+        getPhaseStats(p, phase, 0, &s);
+        if (s.count == 0) continue;
+        fprintf(file, "%s,%d,%.4f,%.4f,%.4f,%.4f,%.4f,%.4f\n", profilePhaseNames[phase], s.count, s.min, s.p50,
+                s.p95, s.p99, s.max, s.mean);
+    }
+    return fclose(file) == 0;
+}
+
+int writeProfileTrace(Profiler *p, char *path)
+{
+    FILE *file = fopen(path, "w");
+    if (file == NULL)
+    {
+        printf("Could not write trace %s!\n", path);
+        return 0;
+    }
+    fprintf(file, "{\"traceEvents\":[");
+    int first = 1;
+    pthread_mutex_lock(&p->lock);
+    for (int phase = 0; phase < PROFILE_PHASE_COUNT; ++phase)
+    {
+        uint64_t count = p->count[phase];
+        int n = count < PROFILE_SAMPLES ? (int) count : PROFILE_SAMPLES;
+        for (int i = 0; i < n; ++i)
+        {
+            ProfileSample *s = &p->samples[phase][(count - n + i) % PROFILE_SAMPLES];
+            fprintf(file, "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",", profilePhaseNames[phase], s->thread, s->start * 1e-3, s->duration * 1e-3);
+            first = 0;
+        }
+    }
+    pthread_mutex_unlock(&p->lock);
+    fprintf(file, "\n],\"displayTimeUnit\":\"ms\"}\n");
+    return fclose(file) == 0;
+}
+
+void destroyProfiler(Profiler *p)
+{
+    pthread_mutex_destroy(&p->lock);
+    free(p);
+}
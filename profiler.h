@@ -0,0 +1,84 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_PROFILER_H
+
+#include <stdint.h>
+#include <pthread.h>
+
+// Samples kept per phase, older ones are overwritten
+#define PROFILE_SAMPLES 4096
+
+typedef enum ProfilePhase_
+{
+    PROFILE_SIMULATE,
+    PROFILE_BRUSH,
+    PROFILE_RAIN,
+    PROFILE_RENDER,
+    PROFILE_PUBLISH,
+    PROFILE_UPLOAD,
+    PROFILE_HUD,
+    PROFILE_PRESENT,
+    PROFILE_PHASE_COUNT
+} ProfilePhase;
+
+extern const char *profilePhaseNames[PROFILE_PHASE_COUNT];
+
+typedef struct ProfileSample_
+{
+    uint64_t start;     // ns since the profiler was created
+    uint32_t duration;  // ns
+    uint32_t thread;
+} ProfileSample;
+
+// Durations of the most recent samples of a phase, in milliseconds
+typedef struct PhaseStats_
+{
+    int count;
+    double min;
+    double max;
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+} PhaseStats;
+
+// Keeps the last PROFILE_SAMPLES timings of every phase. Any thread may time a phase, recording a
+// sample only takes a short lock so the timers can stay on all the time.
+typedef struct Profiler_
+{
+    uint64_t origin;
+    ProfileSample samples[PROFILE_PHASE_COUNT][PROFILE_SAMPLES];
+    uint64_t count[PROFILE_PHASE_COUNT];
+    pthread_mutex_t lock;
+} Profiler;
+
+void createProfiler(Profiler **p);
+
+uint64_t getProfileTime(void);
+
+// Scoped timer: take the start with beginTimer and hand it to endTimer when the phase is done.
+// Both do nothing when p is NULL.
+static inline uint64_t beginTimer(Profiler *p)
+{
+    return p != NULL ? getProfileTime() : 0;
+}
+
+void endTimer(Profiler *p, ProfilePhase phase, uint64_t start);
+
+// Stats over the last window samples of a phase, or all samples kept when window is 0
+void getPhaseStats(Profiler *p, ProfilePhase phase, int window, PhaseStats *s);
+
+// One row of stats per phase. Returns 0 when the file could not be written.
+int writeProfileCsv(Profiler *p, char *path);
+
+// Every sample kept as a complete event, for chrome://tracing or Perfetto. Returns 0 when the file
+// could not be written.
+int writeProfileTrace(Profiler *p, char *path);
+
+void destroyProfiler(Profiler *p);
+
+#define PIXSIM_PROFILER_H
+
+#endif //PIXSIM_PROFILER_H
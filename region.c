@@ -0,0 +1,210 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "region.h"
+
+static uint8_t getFillFlags(World *w, BlockType t, int gravity)
+{
+    if (t == EMPTY) return 0;
+    Color c;
+    getBlockColor(t, &c);
+    return (uint8_t) ((gravity ? BLOCK_GRAVITY : 0) | getShade(w, t, c) << SHADE_SHIFT);
+}
+
+// Half the width of the shape dy rows away from its center, -1 when the row is outside of it
+static int getHalfWidth(Shape s, int radius, int dy)
+{
+    if (dy < 0) dy = -dy;
+    if (dy > radius) return -1;
+    switch (s)
+    {
+        case SHAPE_SQUARE:
+            return radius;
+        case SHAPE_CIRCLE:
+        {
+            int half = radius;
+            while (half * half + dy * dy > radius * radius) half--;
+            return half;
+        }
+        case SHAPE_DIAMOND:
+        default:
+            return radius - dy;
+    }
+}
+
+void fillRect(World *w, BlockType t, int x0, int y0, int x1, int y1, int gravity)
+{
+    uint8_t flags = getFillFlags(w, t, gravity);
+    if (y0 < 0) y0 = 0;
+    if (y1 > w->height) y1 = w->height;
+    for (int y = y0; y < y1 && x1 > x0; ++y) fillRow(w, x0, y, x1 - x0, t, flags);
+}
+
+void clearRect(World *w, int x0, int y0, int x1, int y1)
+{
+    fillRect(w, EMPTY, x0, y0, x1, y1, 0);
+}
+
+void fillShape(World *w, Shape s, BlockType t, int x, int y, int radius, int gravity)
+{
+    stampLine(w, s, t, x, y, x, y, radius, gravity);
+}
+
+void stampLine(World *w, Shape s, BlockType t, int x0, int y0, int x1, int y1, int radius, int gravity)
+{
+    if (radius < 0) return;
+    int minY = (y0 < y1 ? y0 : y1) - radius, maxY = (y0 > y1 ? y0 : y1) + radius;
+    if (minY < 0) minY = 0;
+    if (maxY >= w->height) maxY = w->height - 1;
+    if (minY > maxY) return;
+
+    // The covered span of every row, the shape is convex so the spans of all stamps along the way merge
+    // into one per row
+    int rows = maxY - minY + 1;
+    int *spans = malloc(2 * (size_t) rows * sizeof(int));
+    if (spans == NULL)
+    {
+        printf("Could not allocate stroke of %d rows!\n", rows);
+        exit(1);
+    }
+    for (int i = 0; i < rows; ++i)
+    {
+        spans[2 * i] = INT_MAX;
+        spans[2 * i + 1] = INT_MIN;
+    }
+
+    int dx = abs(x1 - x0), dy = -abs(y1 - y0);
+    int sx = x0 < x1 ? 1 : -1, sy = y0 < y1 ? 1 : -1;
+    int error = dx + dy;
+    int x = x0, y = y0;
+    for (;;)
+    {
+        for (int d = -radius; d <= radius; ++d)
+        {
+            int row = y + d - minY;
+            if (row < 0 || row >= rows) continue;
+            int half = getHalfWidth(s, radius, d);
+            if (x - half < spans[2 * row]) spans[2 * row] = x - half;
+            if (x + half > spans[2 * row + 1]) spans[2 * row + 1] = x + half;
+        }
+
+        if (x == x1 && y == y1) break;
+        int e2 = 2 * error;
+        if (e2 >= dy)
+        {
+            error += dy;
+            x += sx;
+        }
+        if (e2 <= dx)
+        {
+            error += dx;
+            y += sy;
+        }
+    }
+
+    uint8_t flags = getFillFlags(w, t, gravity);
+    for (int i = 0; i < rows; ++i)
+    {
+        if (spans[2 * i] <= spans[2 * i + 1])
+        {
+            fillRow(w, spans[2 * i], minY + i, spans[2 * i + 1] - spans[2 * i] + 1, t, flags);
+        }
+    }
+    free(spans);
+}
+
+void createRegion(Region **r, World *w, int x, int y, int width, int height)
+{
+    Region *nr;
+    nr = malloc(sizeof(Region));
+    if (width < 0) width = 0;
+    if (height < 0) height = 0;
+    nr->width = width;
+    nr->height = height;
+    size_t cells = (size_t) width * height;
+    nr->type = calloc(cells > 0 ? cells : 1, 1);
+    nr->flags = calloc(cells > 0 ? cells : 1, 1);
+    if (nr->type == NULL || nr->flags == NULL)
+    {
+        printf("Could not allocate region of %dx%d!\n", width, height);
+        exit(1);
+    }
+    memcpy(nr->shades, w->shades, sizeof(nr->shades));
+
+    // Only the part inside the world is copied, a chunk at a time and a chunk row segment at a time within it.
+    // Paged out chunks are peeked at and stay out.
+    int cx0 = x < 0 ? 0 : x, cx1 = x + width > w->width ? w->width : x + width;
+    int cy0 = y < 0 ? 0 : y, cy1 = y + height > w->height ? w->height : y + height;
+    Chunk scratch;
+    for (int wy0 = cy0; wy0 < cy1;)
+    {
+        int rows = CHUNK_SIZE - (wy0 & CHUNK_MASK);
+        if (rows > cy1 - wy0) rows = cy1 - wy0;
+        for (int wx = cx0; wx < cx1;)
+        {
+            int n = CHUNK_SIZE - (wx & CHUNK_MASK);
+            if (n > cx1 - wx) n = cx1 - wx;
+            const Chunk *c = peekChunk(w, wx, wy0, &scratch);
+            for (int wy = wy0; c != NULL && wy < wy0 + rows; ++wy)
+            {
+                size_t offset = (size_t) (wy - y) * width + (wx - x);
+                int i = getCellIndex(wx, wy);
+                memcpy(nr->type + offset, c->type + i, n);
+                memcpy(nr->flags + offset, c->flags + i, n);
+            }
+            wx += n;
+        }
+        wy0 += rows;
+    }
+
+    *r = nr;
+}
+
+void pasteRegion(World *w, Region *r, int x, int y, int skipEmpty)
+{
+    if (r->width == 0) return;
+
+    // The region may come from another world, its shades are looked up in this one the first time
+    // they are used
+    int mapped[PALETTE_SIZE];
+    for (int i = 0; i < PALETTE_SIZE; ++i) mapped[i] = -1;
+    uint8_t *flags = malloc((size_t) r->width);
+    if (flags == NULL)
+    {
+        printf("Could not allocate region row!\n");
+        exit(1);
+    }
+
+    for (int ry = 0; ry < r->height; ++ry)
+    {
+        if (y + ry < 0 || y + ry >= w->height) continue;
+        size_t offset = (size_t) ry * r->width;
+        for (int rx = 0; rx < r->width; ++rx)
+        {
+            uint8_t t = r->type[offset + rx], f = r->flags[offset + rx];
+            if (t == EMPTY)
+            {
+                flags[rx] = 0;
+                continue;
+            }
+            int p = getPaletteIndex(t, f);
+            if (mapped[p] < 0) mapped[p] = getShade(w, t, r->shades[t][f >> SHADE_SHIFT]);
+            flags[rx] = (uint8_t) ((f & ((1 << SHADE_SHIFT) - 1)) | mapped[p] << SHADE_SHIFT);
+        }
+        writeRow(w, x, y + ry, r->width, r->type + offset, flags, skipEmpty);
+    }
+    free(flags);
+}
+
+void destroyRegion(Region *r)
+{
+    free(r->type);
+    free(r->flags);
+    free(r);
+}
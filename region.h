@@ -0,0 +1,53 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_REGION_H
+
+#include "world.h"
+
+// Bulk edits of the world, a row segment per chunk at a time through fillRow and writeRow. None of them
+// may be used while the world is being simulated.
+
+typedef enum Shape_
+{
+    // Square of side 2 * radius + 1
+    SHAPE_SQUARE,
+    SHAPE_CIRCLE,
+    // Cells within radius steps, the shape of the brush
+    SHAPE_DIAMOND
+} Shape;
+
+// Cells copied out of a world. Their shades are the ones of the world they came from, which come along.
+typedef struct Region_
+{
+    int width;
+    int height;
+    uint8_t *type;
+    uint8_t *flags;
+    Color shades[BLOCK_TYPE_COUNT][MATERIAL_SHADES];
+} Region;
+
+// Fills x0 <= x < x1, y0 <= y < y1, parts outside the world are left out
+void fillRect(World *w, BlockType t, int x0, int y0, int x1, int y1, int gravity);
+
+void clearRect(World *w, int x0, int y0, int x1, int y1);
+
+void fillShape(World *w, Shape s, BlockType t, int x, int y, int radius, int gravity);
+
+// Fills everything the shape covers while its center moves from x0, y0 to x1, y1, so a fast stroke of
+// the brush leaves no gaps. Every row is written once.
+void stampLine(World *w, Shape s, BlockType t, int x0, int y0, int x1, int y1, int radius, int gravity);
+
+// Copies the cells of a rectangle, cells outside the world come out empty
+void createRegion(Region **r, World *w, int x, int y, int width, int height);
+
+// Writes the region with its lower left corner at x, y. With skipEmpty set the empty cells of the
+// region leave the world as it is.
+void pasteRegion(World *w, Region *r, int x, int y, int skipEmpty);
+
+void destroyRegion(Region *r);
+
+#define PIXSIM_REGION_H
+
+#endif //PIXSIM_REGION_H
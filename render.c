@@ -0,0 +1,131 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "render.h"
+
+
+static uint32_t packColor(Color c)
+{
+    // Matches SDL_PIXELFORMAT_ABGR8888 on little endian machines, bytes are r, g, b, a
+    return (uint32_t) c.r | ((uint32_t) c.g << 8) | ((uint32_t) c.b << 16) | (0xFFu << 24);
+}
+
+void createFrame(Frame **f, int width, int height)
+{
+    Frame *nf;
+    nf = malloc(sizeof(Frame));
+
+    nf->width = width;
+    nf->height = height;
+    nf->pixels = malloc((size_t) width * height * sizeof(uint32_t));
+    nf->rectCapacity = MAX_DIRTY_RECTS;
+    nf->rects = malloc(nf->rectCapacity * sizeof(DirtyRect));
+    nf->rectCount = 0;
+    if (nf->pixels == NULL || nf->rects == NULL)
+    {
+        printf("Could not allocate frame of %dx%d!\n", width, height);
+        exit(1);
+    }
+
+    *f = nf;
+}
+
+void renderChunkRows(World *w, Frame *f, int cx, int cy, uint64_t rows)
+{
+    int x0 = cx << CHUNK_SHIFT, y0 = cy << CHUNK_SHIFT;
+    // Drawing a paged out chunk does not bring it back in
+    Chunk scratch;
+    const Chunk *c = peekChunk(w, x0, y0, &scratch);
+    int width = w->width - x0;
+    if (width > CHUNK_SIZE) width = CHUNK_SIZE;
+
+    while (rows)
+    {
+        int ly = __builtin_ctzll(rows);
+        rows &= rows - 1;
+        int y = y0 + ly;
+        if (y >= w->height) break;
+
+        uint32_t *dst = f->pixels + (size_t) (w->height - 1 - y) * f->width + x0;
+        if (c == NULL)
+        {
+            for (int lx = 0; lx < width; ++lx) dst[lx] = f->palette[0];
+            continue;
+        }
+
+        const uint8_t *type = c->type + (ly << CHUNK_SHIFT);
+        const uint8_t *flags = c->flags + (ly << CHUNK_SHIFT);
+        for (int lx = 0; lx < width; ++lx)
+            dst[lx] = f->palette[type[lx] == EMPTY ? 0 : getPaletteIndex(type[lx], flags[lx])];
+    }
+}
+
+void renderFrame(World *w, Frame *f)
+{
+    for (int t = 0; t < BLOCK_TYPE_COUNT; ++t)
+        for (int s = 0; s < w->shadeCount[t]; ++s) f->palette[t * MATERIAL_SHADES + s] = packColor(w->shades[t][s]);
+
+    f->rectCount = 0;
+    int redrawAll = w->redrawAll;
+    w->redrawAll = 0;
+    if (redrawAll) memset(w->clearedChunks, 0, (size_t) w->chunksX * w->chunksY);
+
+    for (int cy = 0; cy < w->chunksY; ++cy)
+    {
+        for (int cx = 0; cx < w->chunksX; ++cx)
+        {
+            int i = cy * w->chunksX + cx;
+            Chunk *c = w->chunks[i];
+            uint64_t rows = ~0ULL;
+            if (!redrawAll && c == NULL)
+            {
+                // Only released chunks with changes that were never drawn need another look
+                if (!w->clearedChunks[i]) continue;
+                w->clearedChunks[i] = 0;
+            }
+            else if (!redrawAll)
+            {
+                rows = __atomic_exchange_n(&c->dirtyRows, 0, __ATOMIC_RELAXED);
+                if (rows == 0) continue;
+            }
+            else if (c != NULL)
+            {
+                c->dirtyRows = 0;
+            }
+
+            renderChunkRows(w, f, cx, cy, rows);
+
+            if (redrawAll) continue;
+            if (f->rectCount == f->rectCapacity)
+            {
+                redrawAll = 1;
+                continue;
+            }
+
+            // Rows are counted from the bottom of the world but the frame starts at the top
+            int x0 = cx << CHUNK_SHIFT, y0 = cy << CHUNK_SHIFT;
+            int low = y0 + __builtin_ctzll(rows), high = y0 + 63 - __builtin_clzll(rows);
+            if (high >= w->height) high = w->height - 1;
+            int width = w->width - x0 < CHUNK_SIZE ? w->width - x0 : CHUNK_SIZE;
+            f->rects[f->rectCount++] = (DirtyRect) {x0, w->height - 1 - high, width, high - low + 1};
+        }
+    }
+
+    if (redrawAll)
+    {
+        f->rects[0] = (DirtyRect) {0, 0, f->width, f->height};
+        f->rectCount = 1;
+    }
+}
+
+void destroyFrame(Frame *f)
+{
+    free(f->pixels);
+    free(f->rects);
+    free(f);
+}
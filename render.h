@@ -0,0 +1,41 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_RENDER_H
+
+#include <stdint.h>
+
+#include "world.h"
+
+// Past this many changed chunks a single upload of the whole frame is cheaper
+#define MAX_DIRTY_RECTS 64
+
+// Rectangle in frame coordinates, row 0 is the top of the world
+typedef struct DirtyRect_
+{
+    int x, y, w, h;
+} DirtyRect;
+
+// The world drawn at one pixel per cell, RGBA byte order. Only rows that changed since the previous
+// renderFrame get redrawn, rects lists what changed so callers can upload just those parts.
+typedef struct Frame_
+{
+    int width;
+    int height;
+    uint32_t *pixels;
+    uint32_t palette[PALETTE_SIZE];
+    DirtyRect *rects;
+    int rectCount;
+    int rectCapacity;
+} Frame;
+
+void createFrame(Frame **f, int width, int height);
+
+void renderFrame(World *w, Frame *f);
+
+void destroyFrame(Frame *f);
+
+#define PIXSIM_RENDER_H
+
+#endif //PIXSIM_RENDER_H
@@ -0,0 +1,260 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "replay.h"
+
+static void putVarint(FILE *file, uint64_t v)
+{
+    while (v >= 0x80)
+    {
+        fputc((int) (v & 0x7F) | 0x80, file);
+        v >>= 7;
+    }
+    fputc((int) v, file);
+}
+
+// Small negative numbers stay small
+static void putSigned(FILE *file, int v)
+{
+    putVarint(file, v < 0 ? ((uint64_t) -(int64_t) v << 1) - 1 : (uint64_t) v << 1);
+}
+
+static void putLittleEndian(FILE *file, uint64_t v, int bytes)
+{
+    for (int i = 0; i < bytes; ++i) fputc((int) ((v >> (8 * i)) & 0xFF), file);
+}
+
+void createRecorder(Recorder **r, char *path, World *w)
+{
+    Recorder *nr = malloc(sizeof(Recorder));
+    nr->file = fopen(path, "wb");
+    if (nr->file == NULL)
+    {
+        printf("Could not open recording %s!\n", path);
+        exit(1);
+    }
+    nr->frame = 0;
+    nr->lastFrame = 0;
+    initControls(&nr->last);
+
+    fwrite(REPLAY_MAGIC, 1, 4, nr->file);
+    putLittleEndian(nr->file, REPLAY_VERSION, 4);
+    putLittleEndian(nr->file, (uint64_t) w->width, 4);
+    putLittleEndian(nr->file, (uint64_t) w->height, 4);
+    putLittleEndian(nr->file, w->seed, 8);
+
+    *r = nr;
+}
+
+static void putRecord(Recorder *r, InputType type)
+{
+    putVarint(r->file, r->frame - r->lastFrame);
+    fputc(type, r->file);
+    r->lastFrame = r->frame;
+}
+
+static void putValue(Recorder *r, InputType type, int value)
+{
+    putRecord(r, type);
+    putSigned(r->file, value);
+}
+
+// Call once per frame with the controls that frame runs with, before running it
+void recordFrame(Recorder *r, Controls *c)
+{
+    Controls *l = &r->last;
+
+    if (c->reset) putRecord(r, INPUT_RESET);
+    if (getInputButtons(c) != getInputButtons(l)) putValue(r, INPUT_BUTTONS, getInputButtons(c));
+    if ((c->mouseLDown || c->mouseRDown) && (c->mouseX != l->mouseX || c->mouseY != l->mouseY))
+    {
+        putRecord(r, INPUT_MOUSE);
+        putSigned(r->file, c->mouseX);
+        putSigned(r->file, c->mouseY);
+        l->mouseX = c->mouseX;
+        l->mouseY = c->mouseY;
+    }
+    if (c->raining != l->raining) putValue(r, INPUT_RAIN, c->raining);
+    if (c->paused != l->paused) putValue(r, INPUT_PAUSE, c->paused);
+    if (c->brushSize != l->brushSize) putValue(r, INPUT_BRUSH_SIZE, c->brushSize);
+    if (c->brushGravity != l->brushGravity) putValue(r, INPUT_BRUSH_GRAVITY, c->brushGravity);
+    if (c->engine != l->engine) putValue(r, INPUT_ENGINE, c->engine);
+    if (c->material != l->material) putValue(r, INPUT_MATERIAL, c->material);
+    if (c->dispersion != l->dispersion) putValue(r, INPUT_DISPERSION, c->dispersion);
+    if (c->fallSpeed != l->fallSpeed) putValue(r, INPUT_FALL_SPEED, c->fallSpeed);
+
+    int mouseX = l->mouseX, mouseY = l->mouseY;
+    *l = *c;
+    l->mouseX = mouseX;
+    l->mouseY = mouseY;
+    r->frame++;
+}
+
+void destroyRecorder(Recorder *r)
+{
+    putRecord(r, INPUT_END);
+    if (fclose(r->file) != 0) printf("Could not finish recording!\n");
+    free(r);
+}
+
+// Running past the end of the data reads as the end of the recording
+static uint64_t getVarint(Replay *p)
+{
+    uint64_t v = 0;
+    for (int shift = 0; shift < 64; shift += 7)
+    {
+        if (p->offset >= p->size) return 0;
+        uint8_t b = p->data[p->offset++];
+        v |= (uint64_t) (b & 0x7F) << shift;
+        if (!(b & 0x80)) break;
+    }
+    return v;
+}
+
+static int getSigned(Replay *p)
+{
+    uint64_t v = getVarint(p);
+    return (v & 1) ? -(int) (v >> 1) - 1 : (int) (v >> 1);
+}
+
+static void readRecordHeader(Replay *p)
+{
+    uint64_t delta = getVarint(p);
+    if (p->offset >= p->size)
+    {
+        p->next = INPUT_END;
+        p->nextFrame = p->frame;
+        return;
+    }
+    p->nextFrame = p->frame + (uint32_t) delta;
+    p->next = (InputType) p->data[p->offset++];
+}
+
+// Values that follow a record of the given type, -1 when there is no such type
+static int getValueCount(InputType type)
+{
+    switch (type)
+    {
+        case INPUT_END:
+        case INPUT_RESET:
+            return 0;
+        case INPUT_MOUSE:
+            return 2;
+        case INPUT_BUTTONS:
+        case INPUT_RAIN:
+        case INPUT_PAUSE:
+        case INPUT_BRUSH_SIZE:
+        case INPUT_BRUSH_GRAVITY:
+        case INPUT_ENGINE:
+        case INPUT_MATERIAL:
+        case INPUT_DISPERSION:
+        case INPUT_FALL_SPEED:
+            return 1;
+        default:
+            return -1;
+    }
+}
+
+// Walks the records once, a recording has to end with INPUT_END right at the end of the data and its
+// frame count has to fit. Leaves the offset where it was.
+static int checkRecords(Replay *p)
+{
+    size_t start = p->offset;
+    uint64_t frames = 0;
+    int ok = 0;
+    while (p->offset < p->size)
+    {
+        frames += getVarint(p);
+        if (p->offset >= p->size || frames > UINT32_MAX) break;
+        InputType type = (InputType) p->data[p->offset++];
+        int values = getValueCount(type);
+        if (values < 0) break;
+        if (type == INPUT_END)
+        {
+            ok = p->offset == p->size;
+            break;
+        }
+        for (int i = 0; i < values; ++i) getVarint(p);
+    }
+    p->offset = start;
+    return ok;
+}
+
+static uint64_t getLittleEndian(const uint8_t *data, int bytes)
+{
+    uint64_t v = 0;
+    for (int i = 0; i < bytes; ++i) v |= (uint64_t) data[i] << (8 * i);
+    return v;
+}
+
+int createReplay(Replay **p, char *path)
+{
+    FILE *file = fopen(path, "rb");
+    if (file == NULL)
+    {
+        printf("Could not open recording %s!\n", path);
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+
+    Replay *np = malloc(sizeof(Replay));
+    np->data = malloc(size > 0 ? (size_t) size : 1);
+    np->size = size > 0 ? (size_t) size : 0;
+    if (fread(np->data, 1, np->size, file) != np->size || np->size < 24 ||
+        memcmp(np->data, REPLAY_MAGIC, 4) != 0 || getLittleEndian(np->data + 4, 4) != REPLAY_VERSION)
+    {
+        printf("%s is not a valid recording!\n", path);
+        fclose(file);
+        destroyReplay(np);
+        return 0;
+    }
+    fclose(file);
+
+    // Checked like the size of a snapshot, a world is only made for a recording that makes sense
+    uint64_t width = getLittleEndian(np->data + 8, 4), height = getLittleEndian(np->data + 12, 4);
+    np->offset = 24;
+    if (width == 0 || height == 0 || width > 1 << 20 || height > 1 << 20 || !checkRecords(np))
+    {
+        printf("%s is not a valid recording!\n", path);
+        destroyReplay(np);
+        return 0;
+    }
+    np->width = (int) width;
+    np->height = (int) height;
+    np->seed = getLittleEndian(np->data + 16, 8);
+    np->frame = 0;
+    readRecordHeader(np);
+
+    *p = np;
+    return 1;
+}
+
+// Applies the inputs recorded for the current frame, returns 0 once the recording is over
+int replayFrame(Replay *p, Controls *c)
+{
+    while (p->nextFrame == p->frame)
+    {
+        if (p->next == INPUT_END) return 0;
+        // The records were checked when the recording was opened, the mouse comes with x and y
+        InputEvent e = {p->next, 0, 0};
+        int values = getValueCount(p->next);
+        if (values > 0) e.x = getSigned(p);
+        if (values > 1) e.y = getSigned(p);
+        applyInput(c, &e);
+        readRecordHeader(p);
+    }
+    p->frame++;
+    return 1;
+}
+
+void destroyReplay(Replay *p)
+{
+    free(p->data);
+    free(p);
+}
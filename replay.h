@@ -0,0 +1,55 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_REPLAY_H
+
+#include <stdio.h>
+
+#include "input.h"
+
+// Recording file layout:
+//   "PXRP", u32 version, u32 width, u32 height, u64 seed (little endian)
+//   then one record per changed control: varint frames since the last record, u8 InputType, varint values
+// The mouse is only recorded while a button is down, as it does nothing otherwise. A recording starts
+// from an empty world and ends with INPUT_END on the frame after the last one.
+#define REPLAY_MAGIC "PXRP"
+// Version 1 recordings were made with a brush that only painted at the cursor and are not played back
+#define REPLAY_VERSION 2
+
+typedef struct Recorder_
+{
+    FILE *file;
+    uint32_t frame;
+    uint32_t lastFrame;
+    Controls last;
+} Recorder;
+
+typedef struct Replay_
+{
+    uint8_t *data;
+    size_t size;
+    size_t offset;
+    int width;
+    int height;
+    uint64_t seed;
+    uint32_t frame;
+    uint32_t nextFrame;
+    InputType next;
+} Replay;
+
+void createRecorder(Recorder **r, char *path, World *w);
+
+void recordFrame(Recorder *r, Controls *c);
+
+void destroyRecorder(Recorder *r);
+
+int createReplay(Replay **p, char *path);
+
+int replayFrame(Replay *p, Controls *c);
+
+void destroyReplay(Replay *p);
+
+#define PIXSIM_REPLAY_H
+
+#endif //PIXSIM_REPLAY_H
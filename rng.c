@@ -0,0 +1,24 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include "rng.h"
+
+
+static uint64_t splitMix64(uint64_t *x)
+{
+    uint64_t z = (*x += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+void seedRng(Rng *r, uint64_t seed, uint64_t stream)
+{
+    // Mix seed and stream so neighbouring streams do not start out correlated
+    uint64_t x = seed ^ (stream * 0xD1342543DE82EF95ULL);
+    r->state = splitMix64(&x);
+    if (r->state == 0) r->state = splitMix64(&x) | 1;
+    r->bits = 0;
+    r->bitsLeft = 0;
+}
@@ -0,0 +1,52 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_RNG_H
+
+#include <stdint.h>
+
+// Small xorshift64* generator. Every world and every worker owns its own stream so runs are
+// reproducible from a seed and no state is shared between threads.
+typedef struct Rng_
+{
+    uint64_t state;
+    uint64_t bits;
+    int bitsLeft;
+} Rng;
+
+void seedRng(Rng *r, uint64_t seed, uint64_t stream);
+
+static inline uint64_t nextRandom(Rng *r)
+{
+    uint64_t x = r->state;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    r->state = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform value in [0, n)
+static inline uint32_t randomRange(Rng *r, uint32_t n)
+{
+    return (uint32_t) (((nextRandom(r) >> 32) * n) >> 32);
+}
+
+// Coin flip, one 64-bit draw is shared by 64 consecutive flips
+static inline int randomBit(Rng *r)
+{
+    if (r->bitsLeft == 0)
+    {
+        r->bits = nextRandom(r);
+        r->bitsLeft = 64;
+    }
+    int bit = (int) (r->bits & 1);
+    r->bits >>= 1;
+    r->bitsLeft--;
+    return bit;
+}
+
+#define PIXSIM_RNG_H
+
+#endif //PIXSIM_RNG_H
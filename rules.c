@@ -0,0 +1,84 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <pthread.h>
+
+#include "rules.h"
+
+uint8_t neighbourClasses[BLOCK_TYPE_COUNT][BLOCK_TYPE_COUNT];
+uint8_t ruleActions[BLOCK_TYPE_COUNT][RULE_CODES];
+int ruleDirection[BLOCK_TYPE_COUNT];
+
+static pthread_once_t rulesOnce = PTHREAD_ONCE_INIT;
+
+
+static int getClass(BlockType mover, BlockType neighbour)
+{
+    const Material *n = &materials[neighbour];
+    if (neighbour == EMPTY) return CLASS_EMPTY;
+    if ((n->state == STATE_LIQUID || n->state == STATE_GAS) && n->density < materials[mover].density)
+    {
+        return CLASS_LIGHTER;
+    }
+    return CLASS_BLOCKED;
+}
+
+// What a block of material m does in the given neighbourhood, the rules are tried in order of priority
+static Action getAction(const Material *m, int code)
+{
+    int aheadLeft = code & 3, left = (code >> 2) & 3, ahead = (code >> 4) & 3;
+    int right = (code >> 6) & 3, aheadRight = (code >> 8) & 3;
+
+    if (ahead == CLASS_EMPTY) return ACTION_MOVE_AHEAD;
+
+    switch (m->state)
+    {
+        case STATE_SOLID:
+            return ACTION_NONE;
+        case STATE_POWDER:
+            if (ahead == CLASS_LIGHTER)
+            {
+                if (left == CLASS_EMPTY && right == CLASS_EMPTY) return ACTION_SINK_PUSH_SIDEWAYS;
+                if (left == CLASS_EMPTY) return ACTION_SINK_PUSH_LEFT;
+                if (right == CLASS_EMPTY) return ACTION_SINK_PUSH_RIGHT;
+                return ACTION_SINK;
+            }
+            if (!m->slides) return ACTION_NONE;
+            if (aheadLeft == CLASS_EMPTY) return ACTION_MOVE_AHEAD_LEFT;
+            if (aheadRight == CLASS_EMPTY) return ACTION_MOVE_AHEAD_RIGHT;
+            if (aheadLeft == CLASS_LIGHTER) return ACTION_SWAP_AHEAD_LEFT;
+            if (aheadRight == CLASS_LIGHTER) return ACTION_SWAP_AHEAD_RIGHT;
+            return ACTION_NONE;
+        case STATE_LIQUID:
+        case STATE_GAS:
+            if (ahead == CLASS_LIGHTER) return ACTION_SINK;
+            if (left == CLASS_EMPTY && right == CLASS_EMPTY) return ACTION_MOVE_SIDEWAYS;
+            if (left == CLASS_EMPTY) return ACTION_MOVE_LEFT;
+            if (right == CLASS_EMPTY) return ACTION_MOVE_RIGHT;
+            // Pushing in sideways under lighter fluids is what lets them end up on top
+            if (left == CLASS_LIGHTER && right == CLASS_LIGHTER) return ACTION_SWAP_SIDEWAYS;
+            if (left == CLASS_LIGHTER) return ACTION_SWAP_LEFT;
+            if (right == CLASS_LIGHTER) return ACTION_SWAP_RIGHT;
+            return ACTION_NONE;
+    }
+    return ACTION_NONE;
+}
+
+static void buildRules(void)
+{
+    for (int m = 0; m < BLOCK_TYPE_COUNT; ++m)
+    {
+        for (int n = 0; n < BLOCK_TYPE_COUNT; ++n) neighbourClasses[m][n] = (uint8_t) getClass(m, n);
+        for (int code = 0; code < RULE_CODES; ++code)
+        {
+            ruleActions[m][code] = m == EMPTY ? ACTION_NONE : (uint8_t) getAction(&materials[m], code);
+        }
+        ruleDirection[m] = materials[m].state == STATE_GAS ? 1 : -1;
+    }
+}
+
+void initRules(void)
+{
+    pthread_once(&rulesOnce, buildRules);
+}
@@ -0,0 +1,54 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_RULES_H
+
+#include <stdint.h>
+
+#include "block.h"
+
+// How a neighbouring cell looks to the cell that is about to move
+#define CLASS_EMPTY 0
+#define CLASS_LIGHTER 1
+#define CLASS_BLOCKED 2
+#define CLASS_BITS 2
+
+// A neighbourhood code packs the classes of the five cells a block looks at: ahead-left, left, ahead,
+// right and ahead-right, two bits each from the lowest bits up. Ahead is below for everything that
+// falls and above for gases.
+#define RULE_CODES (1 << (5 * CLASS_BITS))
+
+typedef enum Action_
+{
+    ACTION_NONE,
+    ACTION_MOVE_AHEAD,
+    ACTION_MOVE_AHEAD_LEFT,
+    ACTION_MOVE_AHEAD_RIGHT,
+    ACTION_MOVE_LEFT,
+    ACTION_MOVE_RIGHT,
+    // Left or right at random
+    ACTION_MOVE_SIDEWAYS,
+    // Swaps with the cell ahead
+    ACTION_SINK,
+    // Swaps with the cell ahead, then pushes the displaced cell to the side
+    ACTION_SINK_PUSH_LEFT,
+    ACTION_SINK_PUSH_RIGHT,
+    ACTION_SINK_PUSH_SIDEWAYS,
+    ACTION_SWAP_AHEAD_LEFT,
+    ACTION_SWAP_AHEAD_RIGHT,
+    ACTION_SWAP_LEFT,
+    ACTION_SWAP_RIGHT,
+    ACTION_SWAP_SIDEWAYS
+} Action;
+
+// Built once from the material table by initRules
+extern uint8_t neighbourClasses[BLOCK_TYPE_COUNT][BLOCK_TYPE_COUNT];
+extern uint8_t ruleActions[BLOCK_TYPE_COUNT][RULE_CODES];
+extern int ruleDirection[BLOCK_TYPE_COUNT];
+
+void initRules(void);
+
+#define PIXSIM_RULES_H
+
+#endif //PIXSIM_RULES_H
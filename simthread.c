@@ -0,0 +1,226 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+
+#include "simthread.h"
+#include "snapshot.h"
+
+// When the simulation falls this many ticks behind it stops trying to catch up
+#define MAX_TICKS_BEHIND 4
+
+
+// Swaps in the world stored at path, the current one is kept when the file can not be used. The
+// window is already sized for the current world so the snapshot has to match it.
+static World *loadSnapshot(SimThread *s, World *w, char *path)
+{
+    World *loaded;
+    if (!loadWorld(&loaded, path)) return w;
+    if (loaded->width != w->width || loaded->height != w->height)
+    {
+        printf("Snapshot %s is %dx%d, the window shows %dx%d!\n", path, loaded->width, loaded->height, w->width,
+               w->height);
+        destroyWorld(loaded);
+        return w;
+    }
+    loaded->workers = w->workers;
+    loaded->profiler = w->profiler;
+    loaded->engine = w->engine;
+    loaded->sleepChunks = w->sleepChunks;
+    if (s->pageAfter > 0) setChunkPaging(loaded, s->pageAfter, s->pagePath);
+    destroyWorld(w);
+    printf("Loaded %s at tick %llu, %zu KiB\n", path, (unsigned long long) loaded->tick,
+           getWorldMemory(loaded) / 1024);
+    return loaded;
+}
+
+static void handleInput(SimThread *s)
+{
+    InputEvent e;
+    while (popInput(&s->input, &e))
+    {
+        if (e.type == INPUT_SAVE)
+        {
+            if (saveWorld(s->world, s->snapshotPath)) printf("Saved %s\n", s->snapshotPath);
+        }
+        else if (e.type == INPUT_LOAD)
+        {
+            // A recording has to start from an empty world and keep going from there
+            if (s->recorder == NULL && s->replay == NULL) s->world = loadSnapshot(s, s->world, s->snapshotPath);
+        }
+        else applyInput(&s->controls, &e);
+    }
+}
+
+static double getSeconds(struct timespec *t)
+{
+    return t->tv_sec + 1e-9 * t->tv_nsec;
+}
+
+// Takes the input of one frame and runs it, returns 0 once a replay has run out. Every tick is a frame
+// of its own to the recorder, so a recording made in turbo mode plays back the same at any speed.
+static int stepSimulation(SimThread *s)
+{
+    if (s->replay != NULL)
+    {
+        if (!replayFrame(s->replay, &s->controls)) return 0;
+    }
+    else handleInput(s);
+
+    if (s->recorder != NULL) recordFrame(s->recorder, &s->controls);
+    runFrame(s->world, &s->controls);
+    return 1;
+}
+
+static void *runSimulation(void *arg)
+{
+    SimThread *s = arg;
+    long tickNanos = 1000000000L / s->tickRate;
+    struct timespec next, now;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    double rateStart = getSeconds(&next);
+    uint64_t rateTicks = 0;
+    double ticksPerSecond = 0;
+
+    while (!__atomic_load_n(&s->quit, __ATOMIC_ACQUIRE))
+    {
+        // A full turbo frame leaves a quarter of the frame time for rendering and publishing
+        int turbo = __atomic_load_n(&s->turbo, __ATOMIC_RELAXED);
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        double frameEnd = getSeconds(&now) + 0.75e-9 * tickNanos;
+        int finished = 0, ticks = 0;
+        while (1)
+        {
+            finished = !stepSimulation(s);
+            if (finished) break;
+            if (!s->controls.paused) ticks++;
+            // Paused there is nothing to fast forward
+            if (s->controls.paused || turbo == 0) break;
+            if (turbo > 0 && ticks >= turbo) break;
+            if (turbo == TURBO_MAX)
+            {
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                if (getSeconds(&now) >= frameEnd) break;
+            }
+        }
+
+        if (!finished)
+        {
+            uint64_t start = beginTimer(s->world->profiler);
+            renderFrame(s->world, s->frame);
+            endTimer(s->world->profiler, PROFILE_RENDER, start);
+            if (s->capture != NULL) captureFrame(s->capture, s->frame);
+            start = beginTimer(s->world->profiler);
+            publishFrame(s->frames, s->frame);
+            endTimer(s->world->profiler, PROFILE_PUBLISH, start);
+        }
+        rateTicks += ticks;
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        if (getSeconds(&now) - rateStart >= 0.5)
+        {
+            ticksPerSecond = rateTicks / (getSeconds(&now) - rateStart);
+            rateStart = getSeconds(&now);
+            rateTicks = 0;
+        }
+
+        WorldStats stats;
+        getWorldStats(s->world, &stats);
+        pthread_mutex_lock(&s->statusLock);
+        s->status.controls = s->controls;
+        s->status.tick = s->world->tick;
+        s->status.ticksPerSecond = ticksPerSecond;
+        s->status.turbo = turbo;
+        s->status.stats = stats;
+        s->status.finished = finished;
+        pthread_mutex_unlock(&s->statusLock);
+        if (finished)
+        {
+            printf("Replay finished at tick %llu\n", (unsigned long long) s->world->tick);
+            break;
+        }
+
+        next.tv_nsec += tickNanos;
+        while (next.tv_nsec >= 1000000000L)
+        {
+            next.tv_nsec -= 1000000000L;
+            next.tv_sec++;
+        }
+        if (getSeconds(&now) - getSeconds(&next) > MAX_TICKS_BEHIND * 1e-9 * tickNanos) next = now;
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+    }
+    return NULL;
+}
+
+void createSimThread(SimThread **s, World *w, Controls *c, int tickRate)
+{
+    SimThread *ns;
+    ns = malloc(sizeof(SimThread));
+
+    ns->world = w;
+    ns->controls = *c;
+    ns->recorder = NULL;
+    ns->replay = NULL;
+    ns->capture = NULL;
+    ns->snapshotPath = NULL;
+    ns->pageAfter = 0;
+    ns->pagePath = NULL;
+    ns->tickRate = tickRate > 0 ? tickRate : 60;
+    ns->turbo = 0;
+    createFrame(&ns->frame, w->width, w->height);
+    createTripleBuffer(&ns->frames, w->width, w->height);
+    initInputQueue(&ns->input);
+    ns->quit = 0;
+    pthread_mutex_init(&ns->statusLock, NULL);
+    ns->status.controls = *c;
+    ns->status.tick = w->tick;
+    ns->status.ticksPerSecond = 0;
+    ns->status.turbo = 0;
+    getWorldStats(w, &ns->status.stats);
+    ns->status.finished = 0;
+
+    *s = ns;
+}
+
+void startSimThread(SimThread *s)
+{
+    if (pthread_create(&s->thread, NULL, runSimulation, s) != 0)
+    {
+        printf("Could not start simulation thread!\n");
+        exit(1);
+    }
+}
+
+int sendInput(SimThread *s, InputEvent e)
+{
+    return pushInput(&s->input, e);
+}
+
+void setSimTurbo(SimThread *s, int turbo)
+{
+    __atomic_store_n(&s->turbo, turbo, __ATOMIC_RELAXED);
+}
+
+void getSimStatus(SimThread *s, SimStatus *status)
+{
+    pthread_mutex_lock(&s->statusLock);
+    *status = s->status;
+    pthread_mutex_unlock(&s->statusLock);
+}
+
+void stopSimThread(SimThread *s)
+{
+    __atomic_store_n(&s->quit, 1, __ATOMIC_RELEASE);
+    pthread_join(s->thread, NULL);
+}
+
+void destroySimThread(SimThread *s)
+{
+    pthread_mutex_destroy(&s->statusLock);
+    destroyTripleBuffer(s->frames);
+    destroyFrame(s->frame);
+    free(s);
+}
@@ -0,0 +1,79 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_SIMTHREAD_H
+
+#include <pthread.h>
+
+#include "world.h"
+#include "input.h"
+#include "replay.h"
+#include "triplebuffer.h"
+#include "capture.h"
+
+// Turbo setting that runs as many ticks as fit in the time of a frame
+#define TURBO_MAX (-1)
+
+// What the simulation thread last did, for the HUD
+typedef struct SimStatus_
+{
+    Controls controls;
+    uint64_t tick;
+    double ticksPerSecond;
+    int turbo;
+    WorldStats stats;
+    // Set once a replay has run out
+    int finished;
+} SimStatus;
+
+// Runs the world on its own thread at a fixed tick rate. Input comes in through a queue, every tick
+// is rendered and handed out through a triple buffer, so a slow renderer never holds up a tick and
+// the renderer never touches the world.
+typedef struct SimThread_
+{
+    // Owned by the simulation thread while it runs, the world may get replaced by loading a snapshot
+    World *world;
+    Controls controls;
+    Recorder *recorder;
+    Replay *replay;
+    // Gets every rendered frame when set
+    Capture *capture;
+    char *snapshotPath;
+    int pageAfter;
+    char *pagePath;
+    int tickRate;
+    // 0 runs one tick per frame, a positive value that many and TURBO_MAX as many as fit. Only the last
+    // tick of a frame is rendered.
+    int turbo;
+    Frame *frame;
+    TripleBuffer *frames;
+    InputQueue input;
+    pthread_t thread;
+    int quit;
+    pthread_mutex_t statusLock;
+    SimStatus status;
+} SimThread;
+
+// Set up the remaining fields before calling startSimThread
+void createSimThread(SimThread **s, World *w, Controls *c, int tickRate);
+
+void startSimThread(SimThread *s);
+
+// Returns 0 when the queue is full and the input was dropped
+int sendInput(SimThread *s, InputEvent e);
+
+// Takes effect from the next frame on, also while replaying
+void setSimTurbo(SimThread *s, int turbo);
+
+void getSimStatus(SimThread *s, SimStatus *status);
+
+// Waits for the tick in progress to finish, the world and everything else can be used again afterwards
+void stopSimThread(SimThread *s);
+
+// Frees the thread and its frames, not the world, the recorder, the replay or the capture
+void destroySimThread(SimThread *s);
+
+#define PIXSIM_SIMTHREAD_H
+
+#endif //PIXSIM_SIMTHREAD_H
@@ -0,0 +1,323 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <string.h>
+
+#include "simulate.h"
+#include "bitplane.h"
+#include "rules.h"
+
+typedef struct PhaseContext_
+{
+    World *w;
+    int *chunks;
+} PhaseContext;
+
+
+static inline int getChunkPhase(int x, int y)
+{
+    return ((x >> CHUNK_SHIFT) & 1) | (((y >> CHUNK_SHIFT) & 1) << 1);
+}
+
+// Remember that the cell at x, y was already updated this tick. Only needed when the scan still has to
+// reach that cell, which is the case for the current chunk and for chunks in a later phase.
+void markUpdated(World *w, Chunk *current, int x, int y)
+{
+    Chunk *c = getChunk(w, x, y);
+    uint64_t bit = 1ULL << (x & CHUNK_MASK);
+    if (c == current) c->updated[y & CHUNK_MASK] |= bit;
+    else if (getChunkPhase(x, y) > w->phase) __atomic_fetch_or(&c->updated[y & CHUNK_MASK], bit, __ATOMIC_RELAXED);
+}
+
+void moveAndMark(World *w, Chunk *current, int x, int y, int nx, int ny)
+{
+    moveBlock(w, x, y, nx, ny);
+    markUpdated(w, current, nx, ny);
+    current->moved++;
+}
+
+void swapAndMark(World *w, Chunk *current, int x1, int y1, int x2, int y2)
+{
+    swapBlockLocations(w, x1, y1, x2, y2);
+    markUpdated(w, current, x1, y1);
+    markUpdated(w, current, x2, y2);
+    current->moved += 2;
+}
+
+// Like getBlockType, but the row above the world is closed off as well so rising gases stop at the top
+static inline BlockType getNeighbourType(World *w, int x, int y)
+{
+    return y >= w->height ? CONCRETE : getBlockType(w, x, y);
+}
+
+// Moves a block sideways in direction dir, returns 0 when it stays put. With a reach of one it just steps
+// aside. Further than that it runs along the empty row and drops straight into the first gap it passes.
+// Without a gap in reach it stays put, so the uneven top layer of a pool stops wandering about and the
+// pool can go to sleep.
+static int flowSideways(World *w, Chunk *c, const uint8_t *classes, int x, int y, int ay, int dir, int reach)
+{
+    if (reach <= 1)
+    {
+        moveAndMark(w, c, x, y, x + dir, y);
+        return 1;
+    }
+    for (int distance = 1; distance <= reach; ++distance)
+    {
+        int nx = x + dir * distance;
+        if (getNeighbourType(w, nx, y) != EMPTY) return 0;
+        BlockType ahead = getNeighbourType(w, nx, ay);
+        if (ahead == EMPTY)
+        {
+            moveAndMark(w, c, x, y, nx, ay);
+            return 1;
+        }
+        if (classes[ahead] != CLASS_BLOCKED)
+        {
+            moveAndMark(w, c, x, y, nx, y);
+            return 1;
+        }
+    }
+    // Only the end of a run heads out onto an open surface, and only when it stays clear of whatever is
+    // further on. Blocks behind it would follow it and blocks on their own would bounce back and forth.
+    if (getNeighbourType(w, x - dir, y) == EMPTY || getNeighbourType(w, x + dir * (reach + 1), y) != EMPTY)
+    {
+        return 0;
+    }
+    moveAndMark(w, c, x, y, x + dir * reach, y);
+    return 1;
+}
+
+// Drops a block with the empty cell below it down the column, one cell further than last tick up to the
+// fall speed. It stops on top of whatever is in the way and loses its speed when it does. Below its own
+// chunk the column counts tell whether there is anything to stop on, an empty stretch is not looked at.
+void fallAndMark(World *w, Chunk *c, int i, int x, int y)
+{
+    int speed = ((c->flags[i] & BLOCK_SPEED) >> SPEED_SHIFT) + 1;
+    if (speed > w->fallSpeed) speed = w->fallSpeed;
+    int distance = 1;
+    while (distance < speed)
+    {
+        int ny = y - distance - 1;
+        if (ny >= 0 && (ny >> CHUNK_SHIFT) != (y >> CHUNK_SHIFT) &&
+            __atomic_load_n(&w->columnCounts[(size_t) (ny >> CHUNK_SHIFT) * w->width + x], __ATOMIC_RELAXED) == 0)
+        {
+            distance++;
+            continue;
+        }
+        if (getBlockType(w, x, ny) != EMPTY) break;
+        distance++;
+    }
+    c->flags[i] = (uint8_t) ((c->flags[i] & ~BLOCK_SPEED) | (distance == speed ? distance << SPEED_SHIFT : 0));
+    moveAndMark(w, c, x, y, x, y - distance);
+}
+
+void simulateBlock(World *w, Chunk *c, int i, int x, int y, Rng *rng)
+{
+    BlockType t = c->type[i];
+
+    if (t == EMPTY || !(c->flags[i] & BLOCK_GRAVITY)) return;
+    if (c->updated[y & CHUNK_MASK] & (1ULL << (x & CHUNK_MASK))) return;
+
+    // Gather the neighbourhood as seen by this material and look up what to do with it. Away from the
+    // chunk edges every neighbour is in this chunk and can be read straight from its cells.
+    int ay = y + ruleDirection[t];
+    const uint8_t *classes = neighbourClasses[t];
+    int lx = x & CHUNK_MASK, ly = y & CHUNK_MASK;
+    int code;
+    if (lx > 0 && lx < CHUNK_MASK && ly > 0 && ly < CHUNK_MASK && x + 1 < w->width && y + 1 < w->height)
+    {
+        const uint8_t *type = c->type;
+        int ai = i + ruleDirection[t] * CHUNK_SIZE;
+        code = classes[type[ai - 1]] | classes[type[i - 1]] << CLASS_BITS | classes[type[ai]] << (2 * CLASS_BITS) |
+               classes[type[i + 1]] << (3 * CLASS_BITS) | classes[type[ai + 1]] << (4 * CLASS_BITS);
+    }
+    else
+    {
+        code = classes[getNeighbourType(w, x - 1, ay)] |
+               classes[getNeighbourType(w, x - 1, y)] << CLASS_BITS |
+               classes[getNeighbourType(w, x, ay)] << (2 * CLASS_BITS) |
+               classes[getNeighbourType(w, x + 1, y)] << (3 * CLASS_BITS) |
+               classes[getNeighbourType(w, x + 1, ay)] << (4 * CLASS_BITS);
+    }
+
+    int reach = materials[t].state == STATE_LIQUID ? w->dispersion : 1;
+    int dir;
+    Action action = ruleActions[t][code];
+    // Anything but falling straight on stops a falling block
+    if (action != ACTION_MOVE_AHEAD && (c->flags[i] & BLOCK_SPEED)) c->flags[i] &= ~BLOCK_SPEED;
+    switch (action)
+    {
+        case ACTION_MOVE_AHEAD:
+            if (w->fallSpeed > 1 && ay < y) fallAndMark(w, c, i, x, y);
+            else moveAndMark(w, c, x, y, x, ay);
+            break;
+        case ACTION_MOVE_AHEAD_LEFT:
+            moveAndMark(w, c, x, y, x - 1, ay);
+            break;
+        case ACTION_MOVE_AHEAD_RIGHT:
+            moveAndMark(w, c, x, y, x + 1, ay);
+            break;
+        case ACTION_MOVE_LEFT:
+            flowSideways(w, c, classes, x, y, ay, -1, reach);
+            break;
+        case ACTION_MOVE_RIGHT:
+            flowSideways(w, c, classes, x, y, ay, 1, reach);
+            break;
+        case ACTION_MOVE_SIDEWAYS:
+            // The random side first, the other one when there is nowhere to go on that side
+            dir = (randomBit(rng) * 2) - 1;
+            if (!flowSideways(w, c, classes, x, y, ay, dir, reach)) flowSideways(w, c, classes, x, y, ay, -dir, reach);
+            break;
+        case ACTION_SINK:
+            swapAndMark(w, c, x, y, x, ay);
+            break;
+        case ACTION_SINK_PUSH_LEFT:
+            swapAndMark(w, c, x, y, x, ay);
+            moveAndMark(w, c, x, y, x - 1, y);
+            break;
+        case ACTION_SINK_PUSH_RIGHT:
+            swapAndMark(w, c, x, y, x, ay);
+            moveAndMark(w, c, x, y, x + 1, y);
+            break;
+        case ACTION_SINK_PUSH_SIDEWAYS:
+            swapAndMark(w, c, x, y, x, ay);
+            moveAndMark(w, c, x, y, x + ((randomBit(rng) * 2) - 1), y);
+            break;
+        case ACTION_SWAP_AHEAD_LEFT:
+            swapAndMark(w, c, x, y, x - 1, ay);
+            break;
+        case ACTION_SWAP_AHEAD_RIGHT:
+            swapAndMark(w, c, x, y, x + 1, ay);
+            break;
+        case ACTION_SWAP_LEFT:
+            swapAndMark(w, c, x, y, x - 1, y);
+            break;
+        case ACTION_SWAP_RIGHT:
+            swapAndMark(w, c, x, y, x + 1, y);
+            break;
+        case ACTION_SWAP_SIDEWAYS:
+            swapAndMark(w, c, x, y, x + ((randomBit(rng) * 2) - 1), y);
+            break;
+        default:
+            break;
+    }
+}
+
+void simulateRow(World *w, Chunk *c, int x0, int x1, int y, Rng *rng)
+{
+    // A run of liquid flowing the way the scan goes follows its head in a single tick, while one flowing
+    // the other way only loses its head. Far flowing liquids need both directions to level out, so they
+    // get scanned the other way round every other tick.
+    if (w->dispersion > 1 && (w->tick & 1))
+    {
+        for (int x = x1 - 1; x >= x0; --x) simulateBlock(w, c, getCellIndex(x, y), x, y, rng);
+    }
+    else
+    {
+        for (int x = x0; x < x1; ++x) simulateBlock(w, c, getCellIndex(x, y), x, y, rng);
+    }
+}
+
+void simulateChunk(World *w, int cx, int cy, Rng *rng)
+{
+    Chunk *c = w->chunks[cy * w->chunksX + cx];
+    int x0 = cx << CHUNK_SHIFT, y0 = cy << CHUNK_SHIFT;
+    int x1 = x0 + CHUNK_SIZE, y1 = y0 + CHUNK_SIZE;
+    if (x1 > w->width) x1 = w->width;
+    if (y1 > w->height) y1 = w->height;
+
+    // Blocks that moved in from an earlier phase are skipped this tick but may still move on the next
+    uint64_t arrived = 0;
+    for (int i = 0; i < CHUNK_SIZE; ++i) arrived |= c->updated[i];
+
+    // Anything that changes in or next to this chunk from here on wakes it up again for the next tick
+    __atomic_store_n(&c->dirty, arrived != 0, __ATOMIC_RELAXED);
+    c->lastActive = w->tick;
+    c->moved = 0;
+
+    if (w->engine == ENGINE_BITPLANES)
+    {
+        simulateChunkBitplanes(w, c, cx, cy, rng);
+    }
+    else
+    {
+        for (int y = y0; y < y1; ++y) simulateRow(w, c, x0, x1, y, rng);
+    }
+
+    memset(c->updated, 0, sizeof(c->updated));
+}
+
+void simulateChunkTask(void *context, int index, int worker)
+{
+    PhaseContext *phase = context;
+    World *w = phase->w;
+    int chunk = phase->chunks[index];
+    (void) worker;
+
+    // Every chunk gets its own stream for this tick, so the result does not depend on which
+    // worker picked it up or in what order
+    Rng rng;
+    seedRng(&rng, w->seed ^ (w->tick * 0x9E3779B97F4A7C15ULL), (uint64_t) chunk + 1);
+    simulateChunk(w, chunk % w->chunksX, chunk / w->chunksX, &rng);
+}
+
+void simulate(World *w)
+{
+    //printf("Simulation running..\n");
+    initRules();
+    w->tick++;
+    w->awakeChunks = 0;
+    w->movedCells = 0;
+    w->activeBlocks = 0;
+
+    // Checkerboard schedule: chunks sharing a phase are never next to each other, so the cells they
+    // touch (their own plus a one cell border) never overlap and they can run at the same time.
+    // Chunks where nothing changed since they were last updated are asleep and get skipped, a
+    // chunk woken by an earlier phase is still picked up in this tick.
+    PhaseContext phase = {w, w->schedule};
+    for (int p = 0; p < 4; ++p)
+    {
+        int count = 0;
+        for (int cy = p >> 1; cy < w->chunksY; cy += 2)
+        {
+            for (int cx = p & 1; cx < w->chunksX; cx += 2)
+            {
+                int i = cy * w->chunksX + cx;
+                Chunk *c = w->chunks[i];
+                if (c != NULL && (c->dirty || !w->sleepChunks)) w->schedule[count++] = i;
+            }
+        }
+        w->phase = p;
+        w->awakeChunks += count;
+        runTasks(w->workers, count, simulateChunkTask, &phase);
+
+        for (int k = 0; k < count; ++k)
+        {
+            int i = w->schedule[k];
+            const uint16_t *counts = &w->materialCounts[i * BLOCK_TYPE_COUNT];
+            for (int t = 1; t < BLOCK_TYPE_COUNT; ++t) w->activeBlocks += counts[t];
+            w->movedCells += w->chunks[i]->moved;
+        }
+    }
+    w->quietTicks = w->movedCells == 0 ? w->quietTicks + 1 : 0;
+
+    if (w->tick % RELEASE_INTERVAL == 0) releaseIdleChunks(w);
+}
+
+void rain(World *w)
+{
+    int x1, x2;
+
+    x1 = (int) randomRange(&w->rng, w->width);
+    do
+    {
+        x2 = (int) randomRange(&w->rng, w->width);
+    } while (x2 == x1);
+
+    // Drops only start in an empty top cell, they never replace what is already there
+    Color c;
+    getBlockColor(WATER, &c);
+    if (getBlockType(w, x1, w->height - 1) == EMPTY) addBlock(w, WATER, x1, w->height - 1, 1, c);
+    if (getBlockType(w, x2, w->height - 1) == EMPTY) addBlock(w, WATER, x2, w->height - 1, 1, c);
+}
@@ -0,0 +1,31 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_SIMULATE_H
+
+#include "world.h"
+
+void markUpdated(World *w, Chunk *current, int x, int y);
+
+void moveAndMark(World *w, Chunk *current, int x, int y, int nx, int ny);
+
+void swapAndMark(World *w, Chunk *current, int x1, int y1, int x2, int y2);
+
+// Moves the block at cell i of chunk c, at x, y, down by as much as its fall speed allows
+void fallAndMark(World *w, Chunk *c, int i, int x, int y);
+
+void simulateBlock(World *w, Chunk *c, int i, int x, int y, Rng *rng);
+
+// Cells x0 to x1 - 1 of row y, all in chunk c
+void simulateRow(World *w, Chunk *c, int x0, int x1, int y, Rng *rng);
+
+void simulateChunk(World *w, int cx, int cy, Rng *rng);
+
+void simulate(World *w);
+
+void rain(World *w);
+
+#define PIXSIM_SIMULATE_H
+
+#endif //PIXSIM_SIMULATE_H
@@ -0,0 +1,352 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "snapshot.h"
+
+#define RUN_SIZE 4
+#define MAX_RUN 0xFFFF
+
+typedef struct Writer_
+{
+    uint8_t *data;
+    size_t size;
+    size_t capacity;
+} Writer;
+
+// The cells of one chunk of the chunk row being written, NULL when the chunk is empty
+typedef struct BandChunk_
+{
+    const uint8_t *type;
+    const uint8_t *flags;
+} BandChunk;
+
+typedef struct Reader_
+{
+    const uint8_t *data;
+    size_t size;
+    size_t offset;
+    int failed;
+} Reader;
+
+static void reserve(Writer *wr, size_t bytes)
+{
+    if (wr->size + bytes <= wr->capacity) return;
+    size_t capacity = wr->capacity * 2;
+    if (capacity < wr->size + bytes) capacity = wr->size + bytes;
+    uint8_t *data = realloc(wr->data, capacity);
+    if (data == NULL)
+    {
+        printf("Could not grow snapshot buffer!\n");
+        exit(1);
+    }
+    wr->data = data;
+    wr->capacity = capacity;
+}
+
+static void putBytes(Writer *wr, const void *bytes, size_t count)
+{
+    reserve(wr, count);
+    memcpy(wr->data + wr->size, bytes, count);
+    wr->size += count;
+}
+
+static void putU8(Writer *wr, uint8_t v)
+{
+    putBytes(wr, &v, 1);
+}
+
+static void putU16(Writer *wr, uint16_t v)
+{
+    uint8_t b[2] = {(uint8_t) v, (uint8_t) (v >> 8)};
+    putBytes(wr, b, 2);
+}
+
+static void putU32(Writer *wr, uint32_t v)
+{
+    putU16(wr, (uint16_t) v);
+    putU16(wr, (uint16_t) (v >> 16));
+}
+
+static void putU64(Writer *wr, uint64_t v)
+{
+    putU32(wr, (uint32_t) v);
+    putU32(wr, (uint32_t) (v >> 32));
+}
+
+// Running past the end of the file sets failed and reads zeros from then on
+static const uint8_t *take(Reader *r, size_t count)
+{
+    if (r->failed || r->size - r->offset < count)
+    {
+        r->failed = 1;
+        return NULL;
+    }
+    const uint8_t *p = r->data + r->offset;
+    r->offset += count;
+    return p;
+}
+
+static uint8_t getU8(Reader *r)
+{
+    const uint8_t *p = take(r, 1);
+    return p != NULL ? p[0] : 0;
+}
+
+static uint16_t getU16(Reader *r)
+{
+    const uint8_t *p = take(r, 2);
+    return p != NULL ? (uint16_t) (p[0] | (p[1] << 8)) : 0;
+}
+
+static uint32_t getU32(Reader *r)
+{
+    uint32_t lo = getU16(r);
+    return lo | ((uint32_t) getU16(r) << 16);
+}
+
+static uint64_t getU64(Reader *r)
+{
+    uint64_t lo = getU32(r);
+    return lo | ((uint64_t) getU32(r) << 32);
+}
+
+// band holds the chunks of the chunk row y is in
+static void putRow(Writer *wr, World *w, const BandChunk *band, int y)
+{
+    // The run count goes in front of the runs, patch it in once the row is done
+    size_t countOffset = wr->size;
+    putU32(wr, 0);
+    uint32_t runs = 0;
+
+    int x = 0;
+    while (x < w->width)
+    {
+        const BandChunk *c = &band[x >> CHUNK_SHIFT];
+        uint8_t t = EMPTY, f = 0;
+        if (c->type != NULL)
+        {
+            int i = getCellIndex(x, y);
+            t = c->type[i];
+            f = c->flags[i];
+        }
+
+        int length = 1;
+        while (x + length < w->width && length < MAX_RUN)
+        {
+            int nx = x + length;
+            const BandChunk *nc = &band[nx >> CHUNK_SHIFT];
+            if (nc->type == NULL)
+            {
+                if (t != EMPTY || f != 0) break;
+                // A missing chunk is a whole chunk row of empty cells
+                length += CHUNK_SIZE - (nx & CHUNK_MASK);
+                if (x + length > w->width) length = w->width - x;
+                if (length > MAX_RUN) length = MAX_RUN;
+                continue;
+            }
+            int i = getCellIndex(nx, y);
+            if (nc->type[i] != t || nc->flags[i] != f) break;
+            length++;
+        }
+
+        putU16(wr, (uint16_t) length);
+        putU8(wr, t);
+        putU8(wr, f);
+        runs++;
+        x += length;
+    }
+
+    uint8_t *p = wr->data + countOffset;
+    p[0] = (uint8_t) runs;
+    p[1] = (uint8_t) (runs >> 8);
+    p[2] = (uint8_t) (runs >> 16);
+    p[3] = (uint8_t) (runs >> 24);
+}
+
+// Writes the world as it is right now, returns 0 when the file could not be written
+int saveWorld(World *w, char *path)
+{
+    Writer wr = {NULL, 0, 0};
+    reserve(&wr, 4096);
+
+    putBytes(&wr, SNAPSHOT_MAGIC, 4);
+    putU32(&wr, SNAPSHOT_VERSION);
+    putU32(&wr, (uint32_t) w->width);
+    putU32(&wr, (uint32_t) w->height);
+    putU64(&wr, w->tick);
+    putU64(&wr, w->seed);
+    putU64(&wr, w->rng.state);
+    putU64(&wr, w->rng.bits);
+    putU32(&wr, (uint32_t) w->rng.bitsLeft);
+    putU32(&wr, BLOCK_TYPE_COUNT);
+    for (int t = 0; t < BLOCK_TYPE_COUNT; ++t)
+    {
+        putU8(&wr, (uint8_t) w->shadeCount[t]);
+        for (int s = 0; s < w->shadeCount[t]; ++s)
+        {
+            putU8(&wr, w->shades[t][s].r);
+            putU8(&wr, w->shades[t][s].g);
+            putU8(&wr, w->shades[t][s].b);
+        }
+    }
+
+    // Rows go out a chunk row at a time. Resident chunks are read where they are, paged out ones stay out:
+    // they are peeked at into one scratch chunk and only their cells are kept for the chunk row.
+    BandChunk *band = malloc(w->chunksX * sizeof(BandChunk));
+    Chunk *scratch = NULL;
+    uint8_t *coldCells = NULL;
+    if (w->coldChunks > 0)
+    {
+        scratch = malloc(sizeof(Chunk));
+        coldCells = malloc((size_t) w->chunksX * 2 * CHUNK_CELLS);
+    }
+    if (band == NULL || (w->coldChunks > 0 && (scratch == NULL || coldCells == NULL)))
+    {
+        printf("Could not allocate snapshot buffers!\n");
+        exit(1);
+    }
+    for (int cy = 0; cy < w->chunksY; ++cy)
+    {
+        for (int cx = 0; cx < w->chunksX; ++cx)
+        {
+            int x = cx << CHUNK_SHIFT, y = cy << CHUNK_SHIFT;
+            const Chunk *c = scratch != NULL ? peekChunk(w, x, y, scratch) : getChunk(w, x, y);
+            band[cx] = c != NULL ? (BandChunk) {c->type, c->flags} : (BandChunk) {NULL, NULL};
+            if (c != NULL && c == scratch)
+            {
+                uint8_t *cells = coldCells + (size_t) cx * 2 * CHUNK_CELLS;
+                memcpy(cells, c->type, CHUNK_CELLS);
+                memcpy(cells + CHUNK_CELLS, c->flags, CHUNK_CELLS);
+                band[cx] = (BandChunk) {cells, cells + CHUNK_CELLS};
+            }
+        }
+        int y1 = (cy + 1) << CHUNK_SHIFT;
+        if (y1 > w->height) y1 = w->height;
+        for (int y = cy << CHUNK_SHIFT; y < y1; ++y) putRow(&wr, w, band, y);
+    }
+    free(band);
+    free(scratch);
+    free(coldCells);
+
+    FILE *file = fopen(path, "wb");
+    int ok = file != NULL && fwrite(wr.data, 1, wr.size, file) == wr.size;
+    if (file != NULL && fclose(file) != 0) ok = 0;
+    free(wr.data);
+    if (!ok)
+    {
+        printf("Could not write snapshot %s!\n", path);
+        return 0;
+    }
+    return 1;
+}
+
+static int readWorld(Reader *r, World **w)
+{
+    const uint8_t *magic = take(r, 4);
+    if (magic == NULL || memcmp(magic, SNAPSHOT_MAGIC, 4) != 0) return 0;
+    if (getU32(r) != SNAPSHOT_VERSION) return 0;
+
+    uint32_t width = getU32(r), height = getU32(r);
+    if (r->failed || width == 0 || height == 0 || width > 1 << 20 || height > 1 << 20) return 0;
+    // Every row takes at least its run count, a header claiming more rows than that is cut short
+    if (height > (r->size - r->offset) / 4) return 0;
+
+    World *nw;
+    if (!tryCreateWorld(&nw, (int) width, (int) height)) return 0;
+    nw->tick = getU64(r);
+    seedWorld(nw, getU64(r));
+    nw->rng.state = getU64(r);
+    nw->rng.bits = getU64(r);
+    nw->rng.bitsLeft = (int) getU32(r);
+
+    uint32_t materialCount = getU32(r);
+    if (materialCount > BLOCK_TYPE_COUNT) r->failed = 1;
+    for (uint32_t t = 0; t < materialCount && !r->failed; ++t)
+    {
+        int count = getU8(r);
+        if (count < 1 || count > MATERIAL_SHADES) r->failed = 1;
+        for (int s = 0; s < count && !r->failed; ++s)
+        {
+            const uint8_t *p = take(r, 3);
+            if (p != NULL) nw->shades[t][s] = (Color) {p[0], p[1], p[2]};
+        }
+        nw->shadeCount[t] = count;
+    }
+
+    for (uint32_t y = 0; y < height && !r->failed; ++y)
+    {
+        uint32_t runs = getU32(r);
+        const uint8_t *p = take(r, (size_t) runs * RUN_SIZE);
+        if (p == NULL) break;
+
+        uint32_t x = 0;
+        for (uint32_t i = 0; i < runs; ++i, p += RUN_SIZE)
+        {
+            uint32_t length = p[0] | (p[1] << 8);
+            uint8_t t = p[2], f = p[3];
+            if (x + length > width || t >= BLOCK_TYPE_COUNT)
+            {
+                r->failed = 1;
+                break;
+            }
+            if (t != EMPTY && (f >> SHADE_SHIFT) >= nw->shadeCount[t])
+            {
+                r->failed = 1;
+                break;
+            }
+            if (t != EMPTY) fillRow(nw, (int) x, (int) y, (int) length, t, f);
+            x += length;
+        }
+        if (x != width) r->failed = 1;
+    }
+
+    if (r->failed)
+    {
+        destroyWorld(nw);
+        return 0;
+    }
+    *w = nw;
+    return 1;
+}
+
+// Maps the file and builds a new world from it, returns 0 when it is missing or not a valid snapshot
+int loadWorld(World **w, char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0)
+    {
+        printf("Could not open snapshot %s!\n", path);
+        return 0;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size == 0)
+    {
+        printf("Could not read snapshot %s!\n", path);
+        close(fd);
+        return 0;
+    }
+    void *data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED)
+    {
+        printf("Could not map snapshot %s!\n", path);
+        return 0;
+    }
+    // The rows are read front to back exactly once
+    posix_madvise(data, (size_t) st.st_size, POSIX_MADV_SEQUENTIAL);
+
+    Reader r = {data, (size_t) st.st_size, 0, 0};
+    int ok = readWorld(&r, w);
+    munmap(data, (size_t) st.st_size);
+    if (!ok) printf("%s is not a valid snapshot!\n", path);
+    return ok;
+}
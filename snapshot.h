@@ -0,0 +1,26 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_SNAPSHOT_H
+
+#include "world.h"
+
+// Snapshot file layout, all numbers little endian:
+//   "PXSM", u32 version
+//   u32 width, u32 height, u64 tick, u64 seed
+//   u64 rng state, u64 rng bits, u32 rng bits left
+//   u32 material count, then per material u8 shade count and r, g, b bytes per shade
+//   for every row from the bottom up: u32 run count, then per run u16 length, u8 type, u8 flags
+// Block types are stored by their enum value, so new types only ever get appended to BlockType.
+// Only snapshots of this version load, version 1 ones with a single palette are turned down.
+#define SNAPSHOT_MAGIC "PXSM"
+#define SNAPSHOT_VERSION 2
+
+int saveWorld(World *w, char *path);
+
+int loadWorld(World **w, char *path);
+
+#define PIXSIM_SNAPSHOT_H
+
+#endif //PIXSIM_SNAPSHOT_H
@@ -0,0 +1,189 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "text.h"
+
+void createTextCache(TextCache **c, SDL_Renderer *renderer, TTF_Font *font, int capacity)
+{
+    TextCache *nc = malloc(sizeof(TextCache));
+    nc->entries = calloc(capacity, sizeof(TextEntry));
+    if (nc->entries == NULL)
+    {
+        printf("Could not allocate text cache!\n");
+        exit(1);
+    }
+    nc->renderer = renderer;
+    nc->font = font;
+    nc->count = 0;
+    nc->capacity = capacity;
+    nc->clock = 0;
+
+    *c = nc;
+}
+
+static SDL_Texture *renderText(TextCache *c, char *text, SDL_Color color)
+{
+    //We need to first render to a surface as that's what TTF_RenderText
+    //returns, then load that surface into a texture
+    SDL_Surface *surf = TTF_RenderText_Blended(c->font, text, color);
+    if (surf == NULL)
+    {
+        printf("Could not create surface for text!\n");
+        return NULL;
+    }
+
+    SDL_Texture *text_ure = SDL_CreateTextureFromSurface(c->renderer, surf);
+    SDL_FreeSurface(surf);
+    if (text_ure == NULL)
+    {
+        printf("Could not create texture from surface!\n");
+        return NULL;
+    }
+    return text_ure;
+}
+
+// Looks the string up and only renders it when it is not cached yet. The texture stays owned by the
+// cache and is valid until the next call.
+SDL_Texture *getTextTexture(TextCache *c, char *text, SDL_Color color, int *width, int *height)
+{
+    c->clock++;
+
+    TextEntry *e = NULL;
+    for (int i = 0; i < c->count; ++i)
+    {
+        TextEntry *ce = &c->entries[i];
+        if (ce->color.r == color.r && ce->color.g == color.g && ce->color.b == color.b &&
+            ce->color.a == color.a && strcmp(ce->text, text) == 0)
+        {
+            e = ce;
+            break;
+        }
+    }
+
+    if (e == NULL)
+    {
+        if (c->count < c->capacity) e = &c->entries[c->count++];
+        else
+        {
+            e = &c->entries[0];
+            for (int i = 1; i < c->count; ++i)
+                if (c->entries[i].lastUsed < e->lastUsed) e = &c->entries[i];
+            free(e->text);
+            SDL_DestroyTexture(e->texture);
+        }
+
+        e->text = malloc(strlen(text) + 1);
+        strcpy(e->text, text);
+        e->color = color;
+        e->texture = renderText(c, text, color);
+        e->width = 0;
+        e->height = 0;
+        if (e->texture != NULL && SDL_QueryTexture(e->texture, NULL, NULL, &e->width, &e->height) != 0)
+        {
+            printf("Could not query text texture!\n");
+        }
+    }
+
+    e->lastUsed = c->clock;
+    if (width != NULL) *width = e->width;
+    if (height != NULL) *height = e->height;
+    return e->texture;
+}
+
+void drawText(TextCache *c, char *text, SDL_Color color, int x, int y)
+{
+    int tw, th;
+    SDL_Texture *text_ure = getTextTexture(c, text, color, &tw, &th);
+    if (text_ure == NULL) return;
+    SDL_RenderCopy(c->renderer, text_ure, NULL, &(SDL_Rect) {x, y, tw, th});
+}
+
+void destroyTextCache(TextCache *c)
+{
+    for (int i = 0; i < c->count; ++i)
+    {
+        free(c->entries[i].text);
+        if (c->entries[i].texture != NULL) SDL_DestroyTexture(c->entries[i].texture);
+    }
+    free(c->entries);
+    free(c);
+}
+
+void createGlyphAtlas(GlyphAtlas **a, SDL_Renderer *renderer, TTF_Font *font, char *characters)
+{
+    GlyphAtlas *na = malloc(sizeof(GlyphAtlas));
+    memset(na->glyphs, 0, sizeof(na->glyphs));
+    na->renderer = renderer;
+    na->height = TTF_FontHeight(font);
+
+    // One surface per character code, so repeated characters are only rendered once
+    SDL_Surface *surfaces[128] = {NULL};
+    int width = 0;
+    for (char *p = characters; *p != '\0'; ++p)
+    {
+        unsigned char ch = (unsigned char) *p;
+        if (ch >= 128 || surfaces[ch] != NULL) continue;
+        surfaces[ch] = TTF_RenderGlyph_Blended(font, ch, (SDL_Color) {255, 255, 255, 255});
+        if (surfaces[ch] == NULL)
+        {
+            printf("Could not render glyph '%c'!\n", *p);
+            continue;
+        }
+        na->glyphs[ch] = (SDL_Rect) {width, 0, surfaces[ch]->w, surfaces[ch]->h};
+        width += surfaces[ch]->w;
+    }
+
+    SDL_Surface *sheet = SDL_CreateRGBSurfaceWithFormat(0, width > 0 ? width : 1, na->height, 32,
+                                                        SDL_PIXELFORMAT_RGBA32);
+    if (sheet == NULL)
+    {
+        printf("Could not create glyph atlas surface!\n");
+        exit(1);
+    }
+    for (int ch = 0; ch < 128; ++ch)
+    {
+        if (surfaces[ch] == NULL) continue;
+        // Copy the glyph including its alpha instead of blending it onto the empty sheet
+        SDL_SetSurfaceBlendMode(surfaces[ch], SDL_BLENDMODE_NONE);
+        SDL_Rect dst = na->glyphs[ch];
+        SDL_BlitSurface(surfaces[ch], NULL, sheet, &dst);
+        SDL_FreeSurface(surfaces[ch]);
+    }
+
+    na->texture = SDL_CreateTextureFromSurface(renderer, sheet);
+    SDL_FreeSurface(sheet);
+    if (na->texture == NULL)
+    {
+        printf("Could not create glyph atlas texture!\n");
+        exit(1);
+    }
+    SDL_SetTextureBlendMode(na->texture, SDL_BLENDMODE_BLEND);
+
+    *a = na;
+}
+
+// Characters that are not in the atlas are skipped
+void drawGlyphText(GlyphAtlas *a, char *text, SDL_Color color, int x, int y)
+{
+    SDL_SetTextureColorMod(a->texture, color.r, color.g, color.b);
+    SDL_SetTextureAlphaMod(a->texture, color.a);
+    for (char *p = text; *p != '\0'; ++p)
+    {
+        unsigned char ch = (unsigned char) *p;
+        if (ch >= 128 || a->glyphs[ch].w == 0) continue;
+        SDL_Rect src = a->glyphs[ch];
+        SDL_RenderCopy(a->renderer, a->texture, &src, &(SDL_Rect) {x, y, src.w, src.h});
+        x += src.w;
+    }
+}
+
+void destroyGlyphAtlas(GlyphAtlas *a)
+{
+    SDL_DestroyTexture(a->texture);
+    free(a);
+}
@@ -0,0 +1,57 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_TEXT_H
+
+#include <SDL.h>
+#include <SDL_ttf.h>
+
+// Rendered strings, kept around until the least recently used one has to make room
+typedef struct TextEntry_
+{
+    char *text;
+    SDL_Color color;
+    SDL_Texture *texture;
+    int width;
+    int height;
+    unsigned long lastUsed;
+} TextEntry;
+
+typedef struct TextCache_
+{
+    SDL_Renderer *renderer;
+    TTF_Font *font;
+    TextEntry *entries;
+    int count;
+    int capacity;
+    unsigned long clock;
+} TextCache;
+
+// All glyphs of a small character set rendered once into a single white texture. Strings made of
+// those characters are drawn glyph by glyph, tinted with the texture color mod.
+typedef struct GlyphAtlas_
+{
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    SDL_Rect glyphs[128];
+    int height;
+} GlyphAtlas;
+
+void createTextCache(TextCache **c, SDL_Renderer *renderer, TTF_Font *font, int capacity);
+
+SDL_Texture *getTextTexture(TextCache *c, char *text, SDL_Color color, int *width, int *height);
+
+void drawText(TextCache *c, char *text, SDL_Color color, int x, int y);
+
+void destroyTextCache(TextCache *c);
+
+void createGlyphAtlas(GlyphAtlas **a, SDL_Renderer *renderer, TTF_Font *font, char *characters);
+
+void drawGlyphText(GlyphAtlas *a, char *text, SDL_Color color, int x, int y);
+
+void destroyGlyphAtlas(GlyphAtlas *a);
+
+#define PIXSIM_TEXT_H
+
+#endif //PIXSIM_TEXT_H
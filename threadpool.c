@@ -0,0 +1,135 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "threadpool.h"
+
+typedef struct WorkerStart_
+{
+    ThreadPool *pool;
+    int worker;
+} WorkerStart;
+
+
+static void runClaimedTasks(ThreadPool *p, int worker)
+{
+    int index;
+    while ((index = __sync_fetch_and_add(&p->nextTask, 1)) < p->taskCount)
+    {
+        p->task(p->context, index, worker);
+    }
+}
+
+static void *workerMain(void *arg)
+{
+    WorkerStart start = *(WorkerStart *) arg;
+    ThreadPool *p = start.pool;
+    free(arg);
+
+    unsigned seen = 0;
+    while (1)
+    {
+        pthread_mutex_lock(&p->lock);
+        while (p->generation == seen && !p->quit) pthread_cond_wait(&p->workReady, &p->lock);
+        if (p->quit)
+        {
+            pthread_mutex_unlock(&p->lock);
+            return NULL;
+        }
+        seen = p->generation;
+        pthread_mutex_unlock(&p->lock);
+
+        runClaimedTasks(p, start.worker);
+
+        pthread_mutex_lock(&p->lock);
+        if (--p->busyWorkers == 0) pthread_cond_signal(&p->workDone);
+        pthread_mutex_unlock(&p->lock);
+    }
+}
+
+void createThreadPool(ThreadPool **p, int threadCount)
+{
+    ThreadPool *np;
+    np = malloc(sizeof(ThreadPool));
+
+    if (threadCount < 1) threadCount = 1;
+    np->threadCount = threadCount;
+    np->threads = malloc(threadCount * sizeof(pthread_t));
+    pthread_mutex_init(&np->lock, NULL);
+    pthread_cond_init(&np->workReady, NULL);
+    pthread_cond_init(&np->workDone, NULL);
+    np->task = NULL;
+    np->context = NULL;
+    np->taskCount = 0;
+    np->nextTask = 0;
+    np->busyWorkers = 0;
+    np->generation = 0;
+    np->quit = 0;
+
+    for (int i = 1; i < threadCount; ++i)
+    {
+        WorkerStart *start = malloc(sizeof(WorkerStart));
+        start->pool = np;
+        start->worker = i;
+        if (pthread_create(&np->threads[i], NULL, workerMain, start) != 0)
+        {
+            printf("Could not start worker thread!\n");
+            exit(1);
+        }
+    }
+
+    *p = np;
+}
+
+void runTasks(ThreadPool *p, int taskCount, TaskFunction task, void *context)
+{
+    if (taskCount <= 0) return;
+
+    if (p == NULL || p->threadCount == 1 || taskCount == 1)
+    {
+        for (int i = 0; i < taskCount; ++i) task(context, i, 0);
+        return;
+    }
+
+    pthread_mutex_lock(&p->lock);
+    p->task = task;
+    p->context = context;
+    p->taskCount = taskCount;
+    p->nextTask = 0;
+    p->busyWorkers = p->threadCount - 1;
+    p->generation++;
+    pthread_cond_broadcast(&p->workReady);
+    pthread_mutex_unlock(&p->lock);
+
+    runClaimedTasks(p, 0);
+
+    pthread_mutex_lock(&p->lock);
+    while (p->busyWorkers > 0) pthread_cond_wait(&p->workDone, &p->lock);
+    pthread_mutex_unlock(&p->lock);
+}
+
+void destroyThreadPool(ThreadPool *p)
+{
+    pthread_mutex_lock(&p->lock);
+    p->quit = 1;
+    pthread_cond_broadcast(&p->workReady);
+    pthread_mutex_unlock(&p->lock);
+
+    for (int i = 1; i < p->threadCount; ++i) pthread_join(p->threads[i], NULL);
+
+    pthread_mutex_destroy(&p->lock);
+    pthread_cond_destroy(&p->workReady);
+    pthread_cond_destroy(&p->workDone);
+    free(p->threads);
+    free(p);
+}
+
+int getCpuCount(void)
+{
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int) n : 1;
+}
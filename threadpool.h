@@ -0,0 +1,40 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_THREADPOOL_H
+
+#include <pthread.h>
+
+// Called once per task index, worker is in [0, threadCount) and 0 is the calling thread
+typedef void (*TaskFunction)(void *context, int index, int worker);
+
+// Persistent pool of worker threads. The calling thread takes part in every batch of tasks,
+// so a pool of one thread runs everything inline.
+typedef struct ThreadPool_
+{
+    int threadCount;
+    pthread_t *threads;
+    pthread_mutex_t lock;
+    pthread_cond_t workReady;
+    pthread_cond_t workDone;
+    TaskFunction task;
+    void *context;
+    int taskCount;
+    int nextTask;
+    int busyWorkers;
+    unsigned generation;
+    int quit;
+} ThreadPool;
+
+void createThreadPool(ThreadPool **p, int threadCount);
+
+void runTasks(ThreadPool *p, int taskCount, TaskFunction task, void *context);
+
+void destroyThreadPool(ThreadPool *p);
+
+int getCpuCount(void);
+
+#define PIXSIM_THREADPOOL_H
+
+#endif //PIXSIM_THREADPOOL_H
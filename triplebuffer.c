@@ -0,0 +1,93 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "triplebuffer.h"
+
+
+void createTripleBuffer(TripleBuffer **t, int width, int height)
+{
+    TripleBuffer *nt;
+    nt = malloc(sizeof(TripleBuffer));
+
+    for (int i = 0; i < 3; ++i)
+    {
+        createFrame(&nt->frames[i], width, height);
+        nt->pendingCount[i] = -1;
+    }
+    nt->unseenCount = -1;
+    nt->back = 0;
+    nt->middle = 1;
+    nt->front = 2;
+
+    *t = nt;
+}
+
+static void addRects(DirtyRect *list, int *count, Frame *f)
+{
+    if (*count < 0) return;
+    if (*count + f->rectCount > MAX_DIRTY_RECTS)
+    {
+        *count = -1;
+        return;
+    }
+    memcpy(list + *count, f->rects, f->rectCount * sizeof(DirtyRect));
+    *count += f->rectCount;
+}
+
+static void copyRect(Frame *to, Frame *from, DirtyRect r)
+{
+    for (int y = r.y; y < r.y + r.h; ++y)
+    {
+        size_t offset = (size_t) y * from->width + r.x;
+        memcpy(to->pixels + offset, from->pixels + offset, r.w * sizeof(uint32_t));
+    }
+}
+
+void publishFrame(TripleBuffer *t, Frame *source)
+{
+    // The consumer took the last frame and can not take another one until this one is out, so only
+    // the changes of this frame are new to it. Otherwise it may still get the last frame before this
+    // one and is sent a few rects twice, which does no harm.
+    if (!(__atomic_load_n(&t->middle, __ATOMIC_ACQUIRE) & TRIPLE_FRESH)) t->unseenCount = 0;
+    for (int i = 0; i < 3; ++i) addRects(t->pending[i], &t->pendingCount[i], source);
+    addRects(t->unseen, &t->unseenCount, source);
+
+    Frame *back = t->frames[t->back];
+    DirtyRect all = {0, 0, source->width, source->height};
+    if (t->pendingCount[t->back] < 0) copyRect(back, source, all);
+    for (int i = 0; i < t->pendingCount[t->back]; ++i) copyRect(back, source, t->pending[t->back][i]);
+    t->pendingCount[t->back] = 0;
+
+    if (t->unseenCount < 0)
+    {
+        back->rects[0] = all;
+        back->rectCount = 1;
+    }
+    else
+    {
+        memcpy(back->rects, t->unseen, t->unseenCount * sizeof(DirtyRect));
+        back->rectCount = t->unseenCount;
+    }
+
+    int old = __atomic_exchange_n(&t->middle, t->back | TRIPLE_FRESH, __ATOMIC_ACQ_REL);
+    t->back = old & ~TRIPLE_FRESH;
+}
+
+Frame *acquireFrame(TripleBuffer *t)
+{
+    if (!(__atomic_load_n(&t->middle, __ATOMIC_ACQUIRE) & TRIPLE_FRESH)) return NULL;
+
+    int old = __atomic_exchange_n(&t->middle, t->front, __ATOMIC_ACQ_REL);
+    t->front = old & ~TRIPLE_FRESH;
+    return t->frames[t->front];
+}
+
+void destroyTripleBuffer(TripleBuffer *t)
+{
+    for (int i = 0; i < 3; ++i) destroyFrame(t->frames[i]);
+    free(t);
+}
@@ -0,0 +1,42 @@
+//
+// Created by Snowp on 17/10/2026.
+//
+
+#ifndef PIXSIM_TRIPLEBUFFER_H
+
+#include "render.h"
+
+// Middle frame flag, set while it holds a frame the consumer has not taken yet
+#define TRIPLE_FRESH 4
+
+// Hands finished frames from one producer thread to one consumer thread without either ever waiting.
+// The producer draws into the back frame, the consumer shows the front frame and the newest finished
+// frame waits in the middle, publishing and taking a frame both swap with the middle.
+typedef struct TripleBuffer_
+{
+    Frame *frames[3];
+    // Producer side: per frame, the rects it is still missing, count -1 means all of it
+    DirtyRect pending[3][MAX_DIRTY_RECTS];
+    int pendingCount[3];
+    // Producer side: rects changed since the frame the consumer took last
+    DirtyRect unseen[MAX_DIRTY_RECTS];
+    int unseenCount;
+    int back;
+    int front;
+    int middle;
+} TripleBuffer;
+
+void createTripleBuffer(TripleBuffer **t, int width, int height);
+
+// Brings the back frame up to date with source and publishes it. Its rects cover everything that
+// changed since the frame the consumer took last, so uploading just those keeps a texture in sync.
+void publishFrame(TripleBuffer *t, Frame *source);
+
+// The newest published frame, NULL when nothing was published since the last call
+Frame *acquireFrame(TripleBuffer *t);
+
+void destroyTripleBuffer(TripleBuffer *t);
+
+#define PIXSIM_TRIPLEBUFFER_H
+
+#endif //PIXSIM_TRIPLEBUFFER_H
@@ -4,192 +4,840 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include "world.h"
 
+#define COLD_RAW_SIZE (2 * CHUNK_CELLS)
+#define COLD_RUN_SIZE 3
 
-BlockEntry *getBlockEntry(World *w, int x, int y)
+
+// Encodes the cells as runs of count - 1, type, flags. Returns the encoded size, or COLD_RAW_SIZE with
+// the two cell arrays copied as they are when the runs would not be smaller.
+static uint32_t encodeChunk(Chunk *c, uint8_t *out)
 {
-    if (x < -1 || x > w->width || y < -1 || y >= w->height)
+    uint32_t size = 0;
+    for (int i = 0; i < CHUNK_CELLS;)
     {
-        printf("Invalid call to getBlockEntry!\n");
-        exit(1);
+        int n = 1;
+        while (i + n < CHUNK_CELLS && n < 256 && c->type[i + n] == c->type[i] && c->flags[i + n] == c->flags[i]) n++;
+        if (size + COLD_RUN_SIZE >= COLD_RAW_SIZE)
+        {
+            memcpy(out, c->type, CHUNK_CELLS);
+            memcpy(out + CHUNK_CELLS, c->flags, CHUNK_CELLS);
+            return COLD_RAW_SIZE;
+        }
+        out[size++] = (uint8_t) (n - 1);
+        out[size++] = c->type[i];
+        out[size++] = c->flags[i];
+        i += n;
     }
-    return *(w->blockLocations + ((y + 1) * w->simWidth) + x + 1);
+    return size;
 }
 
-void setBlockEntry(World *w, int x, int y, BlockEntry *entry)
+static void decodeChunk(Chunk *c, const uint8_t *in, uint32_t size)
 {
-    if (x < -1 || x > w->width || y < -1 || y >= w->height)
+    if (size == COLD_RAW_SIZE)
     {
-        printf("Invalid call to setBlockEntry!\n");
-        exit(1);
+        memcpy(c->type, in, CHUNK_CELLS);
+        memcpy(c->flags, in + CHUNK_CELLS, CHUNK_CELLS);
+    }
+    else
+    {
+        int i = 0;
+        for (uint32_t r = 0; r < size; r += COLD_RUN_SIZE)
+        {
+            int n = in[r] + 1;
+            memset(c->type + i, in[r + 1], n);
+            memset(c->flags + i, in[r + 2], n);
+            i += n;
+        }
+    }
+
+    for (int i = 0; i < CHUNK_CELLS; ++i)
+    {
+        uint64_t bit = 1ULL << (i & CHUNK_MASK);
+        int row = i >> CHUNK_SHIFT;
+        if (c->type[i] != EMPTY)
+        {
+            c->occupied[row] |= bit;
+            c->material[c->type[i]][row] |= bit;
+        }
+        if (c->flags[i] & BLOCK_GRAVITY) c->gravity[row] |= bit;
     }
-    *(w->blockLocations + ((y + 1) * w->simWidth) + x + 1) = entry;
 }
 
-void getBlock(World *w, int x, int y, Block **b)
+// Decodes the cells of a paged out chunk into c, which has to be cleared. Called with chunkLock held.
+static void readColdChunk(World *w, int index, Chunk *c)
 {
-    if (x < -1 || x > w->width || y < -1 || y >= w->height)
+    ColdChunk *cold = &w->cold[index];
+    if (cold->data != NULL)
     {
-        *b = NULL;
+        decodeChunk(c, cold->data, cold->size);
         return;
     }
-    BlockEntry *be = getBlockEntry(w, x, y);
-    if (be == NULL) *b = NULL;
-    else *b = be->block;
+
+    uint8_t buffer[COLD_RAW_SIZE];
+    if (pread(w->pageFile, buffer, cold->size, (off_t) index * COLD_RAW_SIZE) != (ssize_t) cold->size)
+    {
+        printf("Could not read paged out chunk!\n");
+        exit(1);
+    }
+    decodeChunk(c, buffer, cold->size);
 }
 
-void addBlock(World *w, Block **b, BlockType t, int x, int y)
+// Takes a chunk from the pool for an empty slot, bringing back its cells when it was paged out.
+// Called with chunkLock held.
+static Chunk *allocChunk(World *w, int index)
 {
-    if (x < -1 || x > w->width || y < -1 || y >= w->height)
+    Chunk *c = poolAlloc(w->chunkPool);
+    memset(c, 0, sizeof(Chunk));
+    ColdChunk *cold = w->cold != NULL && w->cold[index].size != 0 ? &w->cold[index] : NULL;
+    if (cold == NULL)
     {
-        *b = NULL;
-        return;
+        c->dirty = 1;
+        __atomic_store_n(&w->chunks[index], c, __ATOMIC_RELEASE);
+        return c;
     }
 
-    Block *nb;
-    getBlock(w, x, y, &nb);
-    if (nb != NULL)
+    readColdChunk(w, index, c);
+    if (cold->data != NULL)
     {
-        //printf("Attempt to create Block which already existed at %d %d! Returned existing Block.\n", x, y);
-        nb->type = t;
-        *b = nb;
-        return;
+        free(cold->data);
+        cold->data = NULL;
+        w->coldBytes -= cold->size;
     }
+    c->lastActive = w->tick;
+    w->coldChunks--;
 
-    createBlock(&nb, t);
-    nb->location = (PairInt) {x, y};
+    // Readers that see the slot still empty check the size next, so the chunk has to be in place first
+    __atomic_store_n(&w->chunks[index], c, __ATOMIC_RELEASE);
+    __atomic_store_n(&cold->size, 0, __ATOMIC_RELEASE);
+    return c;
+}
 
-    BlockEntry *tailp = w->blockTrailer->prev;
-    BlockEntry *newbe = malloc(sizeof(BlockEntry));
-    tailp->next = newbe;
-    w->blockTrailer->prev = newbe;
-    newbe->prev = tailp;
-    newbe->next = w->blockTrailer;
+Chunk *pageInChunk(World *w, int index)
+{
+    // A size of 0 means the chunk was never paged out or was just brought back in by someone else
+    if (__atomic_load_n(&w->cold[index].size, __ATOMIC_ACQUIRE) == 0)
+    {
+        return __atomic_load_n(&w->chunks[index], __ATOMIC_ACQUIRE);
+    }
 
-    newbe->block = nb;
+    pthread_mutex_lock(&w->chunkLock);
+    Chunk *c = w->chunks[index];
+    if (c == NULL) c = allocChunk(w, index);
+    pthread_mutex_unlock(&w->chunkLock);
+    return c;
+}
 
-    setBlockEntry(w, x, y, newbe);
-    nb->entry = newbe;
+const Chunk *peekChunk(World *w, int x, int y, Chunk *scratch)
+{
+    int index = getChunkIndex(w, x, y);
+    Chunk *c = __atomic_load_n(&w->chunks[index], __ATOMIC_ACQUIRE);
+    if (c != NULL || w->cold == NULL) return c;
+    if (__atomic_load_n(&w->cold[index].size, __ATOMIC_ACQUIRE) == 0)
+    {
+        return __atomic_load_n(&w->chunks[index], __ATOMIC_ACQUIRE);
+    }
 
-    *b = nb;
+    pthread_mutex_lock(&w->chunkLock);
+    const Chunk *p = w->chunks[index];
+    if (p == NULL)
+    {
+        memset(scratch, 0, sizeof(Chunk));
+        readColdChunk(w, index, scratch);
+        p = scratch;
+    }
+    pthread_mutex_unlock(&w->chunkLock);
+    return p;
 }
 
-void moveBlock(World *w, Block *b, int x, int y)
+Chunk *ensureChunk(World *w, int x, int y)
 {
-    if (getBlockEntry(w, b->location.x, b->location.y) != b->entry)
+    int index = getChunkIndex(w, x, y);
+    Chunk *c = __atomic_load_n(&w->chunks[index], __ATOMIC_ACQUIRE);
+    if (c != NULL) return c;
+
+    pthread_mutex_lock(&w->chunkLock);
+    c = w->chunks[index];
+    if (c == NULL) c = allocChunk(w, index);
+    pthread_mutex_unlock(&w->chunkLock);
+    return c;
+}
+
+int setChunkPaging(World *w, int afterTicks, char *path)
+{
+    if (w->cold == NULL)
     {
-        printf("World location mapping <-> block entry mismatch during moveBlock!\n");
-        exit(1);
+        w->cold = calloc((size_t) w->chunksX * w->chunksY, sizeof(ColdChunk));
+        if (w->cold == NULL)
+        {
+            printf("Could not allocate paging table!\n");
+            exit(1);
+        }
+    }
+    w->pageAfter = afterTicks < EMPTY_CHUNK_TICKS ? EMPTY_CHUNK_TICKS : afterTicks;
+
+    if (path != NULL && w->pageFile < 0)
+    {
+        w->pageFile = open(path, O_RDWR | O_CREAT | O_TRUNC, 0600);
+        if (w->pageFile < 0)
+        {
+            printf("Could not create page file %s!\n", path);
+            return 0;
+        }
+        unlink(path);
+    }
+    return 1;
+}
+
+static void pageOutChunk(World *w, Chunk *c, int index)
+{
+    uint8_t buffer[COLD_RAW_SIZE];
+    uint32_t size = encodeChunk(c, buffer);
+    ColdChunk *cold = &w->cold[index];
+
+    // Every chunk has its own slot in the page file, the parts never written stay holes
+    if (w->pageFile >= 0)
+    {
+        if (pwrite(w->pageFile, buffer, size, (off_t) index * COLD_RAW_SIZE) != (ssize_t) size)
+        {
+            printf("Could not write paged out chunk!\n");
+            exit(1);
+        }
+        cold->data = NULL;
+    }
+    else
+    {
+        cold->data = malloc(size);
+        if (cold->data == NULL)
+        {
+            printf("Could not allocate paged out chunk!\n");
+            exit(1);
+        }
+        memcpy(cold->data, buffer, size);
+        w->coldBytes += size;
+    }
+    cold->size = size;
+    w->coldChunks++;
+}
+
+void releaseIdleChunks(World *w)
+{
+    int released = 0;
+    for (int i = 0; i < w->chunksX * w->chunksY; ++i)
+    {
+        Chunk *c = w->chunks[i];
+        if (c == NULL || c->dirty || w->tick - c->lastActive < EMPTY_CHUNK_TICKS) continue;
+
+        uint64_t occupied = 0;
+        for (int row = 0; row < CHUNK_SIZE; ++row) occupied |= c->occupied[row];
+        if (occupied != 0)
+        {
+            if (w->cold == NULL || w->tick - c->lastActive < (uint64_t) w->pageAfter) continue;
+            pageOutChunk(w, c, i);
+        }
+
+        // The renderer skips empty slots, unless it is told the chunk is gone
+        if (c->dirtyRows) w->clearedChunks[i] = 1;
+        w->chunks[i] = NULL;
+        poolFree(w->chunkPool, c);
+        released++;
+    }
+    if (released) trimPool(w->chunkPool);
+}
+
+static inline void setPlaneBit(uint64_t *word, uint64_t bit, int set, int shared)
+{
+    if (shared)
+    {
+        if (set) __atomic_fetch_or(word, bit, __ATOMIC_RELAXED);
+        else __atomic_fetch_and(word, ~bit, __ATOMIC_RELAXED);
+    }
+    else if (set) *word |= bit;
+    else *word &= ~bit;
+}
+
+// Adds each set bit of changed to the column counts of a chunk row, or takes it away
+static void countColumns(World *w, int x, int y, uint64_t changed, int delta)
+{
+    uint8_t *counts = w->columnCounts + (size_t) (y >> CHUNK_SHIFT) * w->width + (x & ~CHUNK_MASK);
+    while (changed)
+    {
+        counts[__builtin_ctzll(changed)] += delta;
+        changed &= changed - 1;
+    }
+}
+
+// Stores a cell and keeps the bitplanes and column counts in sync. While simulating, two workers may
+// write opposite edges of a chunk they both border, so writes into any chunk but the one being updated
+// pass shared and change the row words and counts atomically.
+static void writeCell(World *w, Chunk *c, int x, int y, uint8_t type, uint8_t flags, int shared)
+{
+    int i = getCellIndex(x, y);
+    int row = i >> CHUNK_SHIFT;
+    uint64_t bit = 1ULL << (i & CHUNK_MASK);
+    uint8_t oldType = c->type[i];
+
+    if (oldType != type)
+    {
+        uint16_t *counts = &w->materialCounts[getChunkIndex(w, x, y) * BLOCK_TYPE_COUNT];
+        if (oldType != EMPTY)
+        {
+            setPlaneBit(&c->material[oldType][row], bit, 0, shared);
+            if (shared) __atomic_fetch_sub(&counts[oldType], 1, __ATOMIC_RELAXED);
+            else counts[oldType]--;
+        }
+        if (type != EMPTY)
+        {
+            setPlaneBit(&c->material[type][row], bit, 1, shared);
+            if (shared) __atomic_fetch_add(&counts[type], 1, __ATOMIC_RELAXED);
+            else counts[type]++;
+        }
+        if ((oldType == EMPTY) != (type == EMPTY))
+        {
+            setPlaneBit(&c->occupied[row], bit, type != EMPTY, shared);
+            uint8_t *count = &w->columnCounts[(size_t) (y >> CHUNK_SHIFT) * w->width + x];
+            int delta = type != EMPTY ? 1 : -1;
+            if (shared) __atomic_fetch_add(count, delta, __ATOMIC_RELAXED);
+            else *count += delta;
+        }
+    }
+    if ((c->flags[i] ^ flags) & BLOCK_GRAVITY) setPlaneBit(&c->gravity[row], bit, flags & BLOCK_GRAVITY, shared);
+
+    c->type[i] = type;
+    c->flags[i] = flags;
+}
+
+// A change at x, y can affect every cell around it, wake all chunks that neighbourhood overlaps
+void wakeChunksAround(World *w, int x, int y)
+{
+    int cx0 = (x - 1) >> CHUNK_SHIFT, cx1 = (x + 1) >> CHUNK_SHIFT;
+    int cy0 = (y - 1) >> CHUNK_SHIFT, cy1 = (y + 1) >> CHUNK_SHIFT;
+    if (cx0 < 0) cx0 = 0;
+    if (cy0 < 0) cy0 = 0;
+    if (cx1 >= w->chunksX) cx1 = w->chunksX - 1;
+    if (cy1 >= w->chunksY) cy1 = w->chunksY - 1;
+
+    for (int cy = cy0; cy <= cy1; ++cy)
+    {
+        for (int cx = cx0; cx <= cx1; ++cx)
+        {
+            Chunk *c = getChunk(w, cx << CHUNK_SHIFT, cy << CHUNK_SHIFT);
+            if (c != NULL && !__atomic_load_n(&c->dirty, __ATOMIC_RELAXED))
+            {
+                __atomic_store_n(&c->dirty, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+// Wakes the surrounding chunks and flags the row of the cell for the renderer
+void cellChanged(World *w, int x, int y)
+{
+    wakeChunksAround(w, x, y);
+
+    Chunk *c = getChunk(w, x, y);
+    uint64_t row = 1ULL << (y & CHUNK_MASK);
+    if (c != NULL && !(__atomic_load_n(&c->dirtyRows, __ATOMIC_RELAXED) & row))
+    {
+        __atomic_fetch_or(&c->dirtyRows, row, __ATOMIC_RELAXED);
+    }
+}
+
+int isWorldSettled(World *w)
+{
+    // Paged out chunks were asleep when they left and are not looked at
+    for (int i = 0; i < w->chunksX * w->chunksY; ++i)
+    {
+        Chunk *c = __atomic_load_n(&w->chunks[i], __ATOMIC_ACQUIRE);
+        if (c != NULL && __atomic_load_n(&c->dirty, __ATOMIC_RELAXED)) return 0;
+    }
+    return 1;
+}
+
+void setFallSpeed(World *w, int speed)
+{
+    if (speed == w->fallSpeed) return;
+    w->fallSpeed = speed;
+    // Paged out chunks were asleep, nothing in them is falling
+    for (int i = 0; i < w->chunksX * w->chunksY; ++i)
+    {
+        Chunk *c = w->chunks[i];
+        if (c == NULL) continue;
+        for (int j = 0; j < CHUNK_CELLS; ++j) c->flags[j] &= ~BLOCK_SPEED;
+    }
+}
+
+void getWorldStats(World *w, WorldStats *s)
+{
+    memset(s, 0, sizeof(WorldStats));
+    int count = w->chunksX * w->chunksY;
+    for (int i = 0; i < count; ++i)
+    {
+        const uint16_t *counts = &w->materialCounts[i * BLOCK_TYPE_COUNT];
+        for (int t = 1; t < BLOCK_TYPE_COUNT; ++t) s->cells[t] += counts[t];
+        if (w->chunks[i] != NULL) s->chunks++;
+    }
+    for (int t = 1; t < BLOCK_TYPE_COUNT; ++t) s->blocks += s->cells[t];
+    s->cells[EMPTY] = (uint64_t) w->width * w->height - s->blocks;
+    s->tick = w->tick;
+    s->coldChunks = w->coldChunks;
+    s->awakeChunks = w->awakeChunks;
+    s->activeBlocks = w->activeBlocks;
+    s->moved = w->movedCells;
+    s->quietTicks = w->quietTicks;
+    s->settled = isWorldSettled(w);
+}
+
+void getChunkStats(World *w, int cx, int cy, ChunkStats *s)
+{
+    memset(s, 0, sizeof(ChunkStats));
+    int i = cy * w->chunksX + cx;
+    const uint16_t *counts = &w->materialCounts[i * BLOCK_TYPE_COUNT];
+    for (int t = 1; t < BLOCK_TYPE_COUNT; ++t)
+    {
+        s->cells[t] = counts[t];
+        s->blocks += counts[t];
+    }
+    int x0 = cx << CHUNK_SHIFT, y0 = cy << CHUNK_SHIFT;
+    int width = w->width - x0 < CHUNK_SIZE ? w->width - x0 : CHUNK_SIZE;
+    int height = w->height - y0 < CHUNK_SIZE ? w->height - y0 : CHUNK_SIZE;
+    s->cells[EMPTY] = width * height - s->blocks;
+
+    Chunk *c = w->chunks[i];
+    if (c != NULL)
+    {
+        s->moved = c->lastActive == w->tick ? c->moved : 0;
+        s->awake = c->dirty;
+    }
+    s->cold = w->cold != NULL && w->cold[i].size != 0;
+}
+
+uint8_t getShade(World *w, BlockType t, Color c)
+{
+    Color *shades = w->shades[t];
+    int best = 0;
+    int bestDistance = -1;
+    for (int i = 0; i < w->shadeCount[t]; ++i)
+    {
+        Color p = shades[i];
+        int dr = p.r - c.r, dg = p.g - c.g, db = p.b - c.b;
+        int distance = dr * dr + dg * dg + db * db;
+        if (distance == 0) return (uint8_t) i;
+        if (bestDistance < 0 || distance < bestDistance)
+        {
+            best = i;
+            bestDistance = distance;
+        }
+    }
+
+    if (w->shadeCount[t] < MATERIAL_SHADES)
+    {
+        shades[w->shadeCount[t]] = c;
+        return (uint8_t) w->shadeCount[t]++;
+    }
+    // All shades are taken, fall back to the closest one
+    return (uint8_t) best;
+}
+
+int getColumnCount(World *w, int x)
+{
+    int count = 0;
+    for (int cy = 0; cy < w->chunksY; ++cy) count += w->columnCounts[(size_t) cy * w->width + x];
+    return count;
+}
+
+// The counts tell which chunk holds the cell looked for, only that chunk's occupied plane is read. Paged
+// out chunks are peeked at and stay out.
+int getColumnTop(World *w, int x)
+{
+    uint64_t bit = 1ULL << (x & CHUNK_MASK);
+    Chunk scratch;
+    for (int cy = w->chunksY - 1; cy >= 0; --cy)
+    {
+        if (w->columnCounts[(size_t) cy * w->width + x] == 0) continue;
+        const Chunk *c = peekChunk(w, x, cy << CHUNK_SHIFT, &scratch);
+        for (int row = CHUNK_MASK; row >= 0; --row)
+        {
+            if (c->occupied[row] & bit) return (cy << CHUNK_SHIFT) + row;
+        }
     }
-    setBlockEntry(w, b->location.x, b->location.y, NULL);
+    return -1;
+}
+
+int getColumnFree(World *w, int x)
+{
+    uint64_t bit = 1ULL << (x & CHUNK_MASK);
+    Chunk scratch;
+    for (int cy = 0; cy < w->chunksY; ++cy)
+    {
+        int y = cy << CHUNK_SHIFT;
+        int rows = w->height - y < CHUNK_SIZE ? w->height - y : CHUNK_SIZE;
+        int count = w->columnCounts[(size_t) cy * w->width + x];
+        if (count == rows) continue;
+        if (count == 0) return y;
+        const Chunk *c = peekChunk(w, x, y, &scratch);
+        for (int row = 0; row < rows; ++row)
+        {
+            if (!(c->occupied[row] & bit)) return y + row;
+        }
+    }
+    return w->height;
+}
+
+void getBlock(World *w, int x, int y, Block *b)
+{
     b->location = (PairInt) {x, y};
-    setBlockEntry(w, b->location.x, b->location.y, b->entry);
+    if (!isInWorld(w, x, y))
+    {
+        b->type = getBlockType(w, x, y);
+        b->gravity = 0;
+        getBlockColor(b->type, &b->color);
+        return;
+    }
+
+    Chunk *c = getChunk(w, x, y);
+    if (c == NULL)
+    {
+        b->type = EMPTY;
+        b->gravity = 0;
+        b->color = w->shades[EMPTY][0];
+        return;
+    }
+    int i = getCellIndex(x, y);
+    b->type = c->type[i];
+    b->gravity = (c->flags[i] & BLOCK_GRAVITY) != 0;
+    b->color = w->shades[c->type[i]][c->flags[i] >> SHADE_SHIFT];
+}
+
+void addBlock(World *w, BlockType t, int x, int y, int gravity, Color c)
+{
+    if (!isInWorld(w, x, y)) return;
+
+    Chunk *ch = ensureChunk(w, x, y);
+    uint8_t flags = t != EMPTY ? (uint8_t) ((gravity ? BLOCK_GRAVITY : 0) | getShade(w, t, c) << SHADE_SHIFT) : 0;
+    writeCell(w, ch, x, y, t, flags, 0);
+    cellChanged(w, x, y);
 }
 
-void swapBlockLocations(World *w, Block *b1, Block *b2)
+void moveBlock(World *w, int x, int y, int nx, int ny)
 {
-    if (getBlockEntry(w, b1->location.x, b1->location.y) != b1->entry)
+    if (!isInWorld(w, x, y) || !isInWorld(w, nx, ny))
     {
-        printf("World location mapping <-> block entry mismatch during swapBlockLocations b1!\n");
+        printf("Invalid call to moveBlock!\n");
         exit(1);
     }
-    if (getBlockEntry(w, b2->location.x, b2->location.y) != b2->entry)
+
+    Chunk *from = getChunk(w, x, y), *to = ensureChunk(w, nx, ny);
+    if (from == NULL)
+    {
+        printf("Attempted to move Block out of an empty chunk!\n");
+        exit(1);
+    }
+    int i = getCellIndex(x, y);
+    writeCell(w, to, nx, ny, from->type[i], from->flags[i], to != from);
+    writeCell(w, from, x, y, EMPTY, 0, 0);
+    cellChanged(w, x, y);
+    cellChanged(w, nx, ny);
+}
+
+void swapBlockLocations(World *w, int x1, int y1, int x2, int y2)
+{
+    if (!isInWorld(w, x1, y1) || !isInWorld(w, x2, y2))
     {
-        printf("World location mapping <-> block entry mismatch during swapBlockLocations b2!\n");
+        printf("Invalid call to swapBlockLocations!\n");
         exit(1);
     }
 
-    PairInt l1 = b1->location;
-    PairInt l2 = b2->location;
+    Chunk *c1 = ensureChunk(w, x1, y1), *c2 = ensureChunk(w, x2, y2);
+    int i = getCellIndex(x1, y1), j = getCellIndex(x2, y2);
+    uint8_t t = c1->type[i], f = c1->flags[i];
+    writeCell(w, c1, x1, y1, c2->type[j], c2->flags[j], 0);
+    writeCell(w, c2, x2, y2, t, f, c2 != c1);
+    cellChanged(w, x1, y1);
+    cellChanged(w, x2, y2);
+}
+
+void deleteBlock(World *w, int x, int y)
+{
+    if (!isInWorld(w, x, y)) return;
 
-    b1->location = (PairInt) {l2.x, l2.y};
-    b2->location = (PairInt) {l1.x, l1.y};
-    setBlockEntry(w, b1->location.x, b1->location.y, b1->entry);
-    setBlockEntry(w, b2->location.x, b2->location.y, b2->entry);
+    Chunk *c = getChunk(w, x, y);
+    if (c == NULL) return;
+    int i = getCellIndex(x, y);
+    if (c->type[i] == EMPTY) return;
+    writeCell(w, c, x, y, EMPTY, 0, 0);
+    cellChanged(w, x, y);
 }
 
-void deleteBlock(World *w, Block *b)
+// Stores count copies of one cell starting at x, y. The row is written a chunk at a time, setting the
+// bitplanes with one mask per chunk. Not for use while the world is being simulated.
+void fillRow(World *w, int x, int y, int count, uint8_t type, uint8_t flags)
 {
-    BlockEntry *e = b->entry;
-    if (e == NULL)
+    if (y < 0 || y >= w->height) return;
+    if (x < 0)
     {
-        printf("Attempted to delete Block with NULL as entry!! What went wrong?!");
-        exit(1);
+        count += x;
+        x = 0;
     }
+    if (x + count > w->width) count = w->width - x;
 
-    setBlockEntry(w, b->location.x, b->location.y, NULL);
+    int row = y & CHUNK_MASK;
+    while (count > 0)
+    {
+        int n = CHUNK_SIZE - (x & CHUNK_MASK);
+        if (n > count) n = count;
 
-    destroyBlock(b);
+        Chunk *c = type == EMPTY ? getChunk(w, x, y) : ensureChunk(w, x, y);
+        if (c != NULL)
+        {
+            uint64_t bits = (n == CHUNK_SIZE ? ~0ULL : (1ULL << n) - 1) << (x & CHUNK_MASK);
+            uint16_t *counts = &w->materialCounts[getChunkIndex(w, x, y) * BLOCK_TYPE_COUNT];
+            for (int t = 1; t < BLOCK_TYPE_COUNT; ++t)
+            {
+                counts[t] -= __builtin_popcountll(c->material[t][row] & bits);
+                c->material[t][row] &= ~bits;
+            }
+            if (type != EMPTY)
+            {
+                counts[type] += n;
+                countColumns(w, x, y, bits & ~c->occupied[row], 1);
+                c->material[type][row] |= bits;
+                c->occupied[row] |= bits;
+            }
+            else
+            {
+                countColumns(w, x, y, bits & c->occupied[row], -1);
+                c->occupied[row] &= ~bits;
+            }
+            if (flags & BLOCK_GRAVITY) c->gravity[row] |= bits;
+            else c->gravity[row] &= ~bits;
 
-    BlockEntry *p = e->prev;
-    BlockEntry *n = e->next;
-    p->next = n;
-    n->prev = p;
-    free(e);
+            int i = getCellIndex(x, y);
+            memset(c->type + i, type, n);
+            memset(c->flags + i, flags, n);
+            c->dirtyRows |= 1ULL << row;
+
+            wakeChunksAround(w, x, y);
+            wakeChunksAround(w, x + n - 1, y);
+        }
+
+        x += n;
+        count -= n;
+    }
 }
 
-void createWorld(World **w, int width, int height)
+// Sets every bitplane word of a chunk row from its cells
+static void rebuildRowPlanes(Chunk *c, int row)
+{
+    uint64_t planes[BLOCK_TYPE_COUNT] = {0};
+    uint64_t gravity = 0;
+    const uint8_t *type = c->type + (row << CHUNK_SHIFT), *flags = c->flags + (row << CHUNK_SHIFT);
+    for (int x = 0; x < CHUNK_SIZE; ++x)
+    {
+        planes[type[x]] |= 1ULL << x;
+        if (flags[x] & BLOCK_GRAVITY) gravity |= 1ULL << x;
+    }
+    for (int t = 1; t < BLOCK_TYPE_COUNT; ++t) c->material[t][row] = planes[t];
+    c->occupied[row] = ~planes[EMPTY];
+    c->gravity[row] = gravity;
+}
+
+// Stores count cells from the given arrays starting at x, y. Like fillRow the row is written a chunk at
+// a time, the bitplanes of each chunk row are rebuilt once afterwards. With skipEmpty set, empty source
+// cells leave what is in the world. Not for use while the world is being simulated.
+void writeRow(World *w, int x, int y, int count, const uint8_t *type, const uint8_t *flags, int skipEmpty)
+{
+    if (y < 0 || y >= w->height) return;
+    if (x < 0)
+    {
+        type -= x;
+        flags -= x;
+        count += x;
+        x = 0;
+    }
+    if (x + count > w->width) count = w->width - x;
+
+    int row = y & CHUNK_MASK;
+    while (count > 0)
+    {
+        int n = CHUNK_SIZE - (x & CHUNK_MASK);
+        if (n > count) n = count;
+
+        int occupied = 0;
+        for (int k = 0; k < n && !occupied; ++k) occupied = type[k] != EMPTY;
+        Chunk *c = occupied ? ensureChunk(w, x, y) : skipEmpty ? NULL : getChunk(w, x, y);
+        if (c != NULL)
+        {
+            int i = getCellIndex(x, y);
+            if (skipEmpty)
+            {
+                for (int k = 0; k < n; ++k)
+                {
+                    if (type[k] == EMPTY) continue;
+                    c->type[i + k] = type[k];
+                    c->flags[i + k] = flags[k];
+                }
+            }
+            else
+            {
+                memcpy(c->type + i, type, n);
+                memcpy(c->flags + i, flags, n);
+            }
+            uint64_t occupied = c->occupied[row];
+            uint16_t *counts = &w->materialCounts[getChunkIndex(w, x, y) * BLOCK_TYPE_COUNT];
+            for (int t = 1; t < BLOCK_TYPE_COUNT; ++t) counts[t] -= __builtin_popcountll(c->material[t][row]);
+            rebuildRowPlanes(c, row);
+            for (int t = 1; t < BLOCK_TYPE_COUNT; ++t) counts[t] += __builtin_popcountll(c->material[t][row]);
+            countColumns(w, x, y, c->occupied[row] & ~occupied, 1);
+            countColumns(w, x, y, occupied & ~c->occupied[row], -1);
+            c->dirtyRows |= 1ULL << row;
+
+            wakeChunksAround(w, x, y);
+            wakeChunksAround(w, x + n - 1, y);
+        }
+
+        x += n;
+        type += n;
+        flags += n;
+        count -= n;
+    }
+}
+
+int tryCreateWorld(World **w, int width, int height)
 {
     World *nw;
     nw = malloc(sizeof(World));
+    if (nw == NULL) return 0;
 
     nw->width = width;
     nw->height = height;
-    nw->simWidth = width + 2;
-    nw->simHeight = height + 1;
+    nw->chunksX = (width + CHUNK_MASK) >> CHUNK_SHIFT;
+    nw->chunksY = (height + CHUNK_MASK) >> CHUNK_SHIFT;
+    size_t chunkCount = (size_t) nw->chunksX * nw->chunksY;
+    nw->chunks = calloc(chunkCount, sizeof(Chunk *));
+    nw->schedule = malloc(chunkCount * sizeof(int));
+    nw->clearedChunks = calloc(chunkCount, 1);
+    nw->columnCounts = calloc((size_t) nw->chunksY * width, 1);
+    nw->materialCounts = calloc(chunkCount * BLOCK_TYPE_COUNT, sizeof(uint16_t));
+    if (nw->chunks == NULL || nw->schedule == NULL || nw->clearedChunks == NULL || nw->columnCounts == NULL ||
+        nw->materialCounts == NULL)
+    {
+        free(nw->chunks);
+        free(nw->schedule);
+        free(nw->clearedChunks);
+        free(nw->columnCounts);
+        free(nw->materialCounts);
+        free(nw);
+        return 0;
+    }
 
-    nw->blockHeader = malloc(sizeof(BlockEntry));
-    nw->blockTrailer = malloc(sizeof(BlockEntry));
-    nw->blockHeader->next = nw->blockTrailer;
-    nw->blockTrailer->prev = nw->blockHeader;
-    nw->blockLocations = calloc(nw->simWidth * nw->simHeight, sizeof(BlockEntry *));
+    createPool(&nw->chunkPool, sizeof(Chunk), CHUNKS_PER_SLAB);
+    pthread_mutex_init(&nw->chunkLock, NULL);
+    nw->workers = NULL;
+    nw->profiler = NULL;
+    nw->cold = NULL;
+    nw->coldChunks = 0;
+    nw->coldBytes = 0;
+    nw->pageAfter = 0;
+    nw->pageFile = -1;
 
-    Block *b;
-    for (int x = -1; x <= width; ++x)
+    nw->tick = 0;
+    nw->phase = 0;
+    nw->sleepChunks = 1;
+    nw->engine = ENGINE_CELLS;
+    nw->dispersion = 1;
+    nw->fallSpeed = 1;
+    nw->awakeChunks = 0;
+    nw->movedCells = 0;
+    nw->activeBlocks = 0;
+    nw->quietTicks = 0;
+    nw->redrawAll = 1;
+
+    // Empty cells always show shade 0 of EMPTY, keep it black
+    for (int t = 0; t < BLOCK_TYPE_COUNT; ++t)
     {
-        addBlock(nw, &b, CONCRETE, x, -1);
-        b->gravity = 0;
+        Color c;
+        getBlockColor((BlockType) t, &c);
+        nw->shadeCount[t] = 0;
+        getShade(nw, (BlockType) t, t == EMPTY ? (Color) {0, 0, 0} : c);
     }
-    for (int y = 0; y < height; ++y)
+
+    seedWorld(nw, 0);
+
+    *w = nw;
+    return 1;
+}
+
+void createWorld(World **w, int width, int height)
+{
+    if (!tryCreateWorld(w, width, height))
     {
-        addBlock(nw, &b, CONCRETE, -1, y);
-        b->gravity = 0;
-        addBlock(nw, &b, CONCRETE, width, y);
-        b->gravity = 0;
+        printf("Could not allocate world of %dx%d!\n", width, height);
+        exit(1);
     }
+}
 
-    *w = nw;
+void seedWorld(World *w, uint64_t seed)
+{
+    w->seed = seed;
+    seedRng(&w->rng, seed, 0);
 }
 
 void resetWorld(World *w)
 {
-    BlockEntry *e = w->blockHeader->next;
-    Block *b;
-    while (e != w->blockTrailer)
+    // Hand every chunk back at once, they get cleared again when reused
+    resetPool(w->chunkPool);
+    memset(w->chunks, 0, (size_t) w->chunksX * w->chunksY * sizeof(Chunk *));
+    memset(w->clearedChunks, 0, (size_t) w->chunksX * w->chunksY);
+    memset(w->columnCounts, 0, (size_t) w->chunksY * w->width);
+    memset(w->materialCounts, 0, (size_t) w->chunksX * w->chunksY * BLOCK_TYPE_COUNT * sizeof(uint16_t));
+    w->movedCells = 0;
+    w->activeBlocks = 0;
+    w->quietTicks = 0;
+    if (w->cold != NULL)
     {
-        b = e->block;
-        e = e->next;
-        if (b->location.x >= 0 && b->location.x < w->width && b->location.y >= 0 && b->location.y < w->height)
-        {
-            deleteBlock(w, b);
-        }
+        for (int i = 0; i < w->chunksX * w->chunksY; ++i) free(w->cold[i].data);
+        memset(w->cold, 0, (size_t) w->chunksX * w->chunksY * sizeof(ColdChunk));
+        w->coldChunks = 0;
+        w->coldBytes = 0;
     }
+    w->redrawAll = 1;
+}
+
+void getWorldAllocStats(World *w, PoolStats *s)
+{
+    getPoolStats(w->chunkPool, s);
+}
+
+size_t getWorldMemory(World *w)
+{
+    PoolStats ps;
+    getPoolStats(w->chunkPool, &ps);
+    size_t tables = (size_t) w->chunksX * w->chunksY * (sizeof(Chunk *) + sizeof(int) + 1);
+    tables += (size_t) w->chunksY * w->width;
+    tables += (size_t) w->chunksX * w->chunksY * BLOCK_TYPE_COUNT * sizeof(uint16_t);
+    if (w->cold != NULL) tables += (size_t) w->chunksX * w->chunksY * sizeof(ColdChunk);
+    return sizeof(World) + tables + ps.bytes + w->coldBytes;
 }
 
 void destroyWorld(World *w)
 {
-    BlockEntry *e = w->blockHeader->next;
-    BlockEntry *n;
-    while (e != w->blockTrailer)
+    destroyPool(w->chunkPool);
+    pthread_mutex_destroy(&w->chunkLock);
+    free(w->chunks);
+    free(w->schedule);
+    free(w->clearedChunks);
+    free(w->columnCounts);
+    free(w->materialCounts);
+    if (w->cold != NULL)
     {
-        destroyBlock(e->block);
-        n = e->next;
-        free(e);
-        e = n;
+        for (int i = 0; i < w->chunksX * w->chunksY; ++i) free(w->cold[i].data);
+        free(w->cold);
     }
-    free(w->blockHeader);
-    free(w->blockTrailer);
-
-    free(w->blockLocations);
+    if (w->pageFile >= 0) close(w->pageFile);
+    free(w);
 }
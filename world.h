@@ -4,44 +4,268 @@
 
 #ifndef PIXSIM_WORLD_H
 
+#include <stdint.h>
+#include <pthread.h>
+
 #include "block.h"
+#include "pool.h"
+#include "rng.h"
+#include "threadpool.h"
+#include "profiler.h"
+
+// The world is stored as square tiles of cells so that a row of a tile is contiguous in memory.
+// Tiles are only allocated once something is placed in them and freed again once they are empty.
+#define CHUNK_SHIFT 6
+#define CHUNK_SIZE (1 << CHUNK_SHIFT)
+#define CHUNK_MASK (CHUNK_SIZE - 1)
+#define CHUNK_CELLS (CHUNK_SIZE * CHUNK_SIZE)
+
+#define CHUNKS_PER_SLAB 16
+
+// Every this many ticks chunks that slept long enough are released. Empty ones are freed after
+// EMPTY_CHUNK_TICKS, the others go to cold storage when paging is turned on.
+#define RELEASE_INTERVAL 16
+#define EMPTY_CHUNK_TICKS 32
+
+// Colors a frame can show, every shade of every material
+#define PALETTE_SIZE (BLOCK_TYPE_COUNT * MATERIAL_SHADES)
+
+// How far a liquid may flow sideways in one tick. Chunks sharing a phase are one chunk apart, so as long
+// as cells look no further than half a chunk past their own they never reach cells another worker is
+// touching.
+#define MAX_DISPERSION (CHUNK_SIZE / 2 - 1)
 
-typedef struct BlockEntry_
+// Fastest a block can fall in cells per tick, as much as fits in BLOCK_SPEED
+#define MAX_FALL_SPEED (BLOCK_SPEED >> SPEED_SHIFT)
+
+typedef enum Engine_
+{
+    // Updates one cell at a time
+    ENGINE_CELLS,
+    // Updates a whole chunk row at a time from the bitplanes
+    ENGINE_BITPLANES
+} Engine;
+
+typedef struct Chunk_
 {
-    struct BlockEntry_ *prev;
-    struct BlockEntry_ *next;
-    Block *block;
-} BlockEntry;
+    // Set when something changed in or right next to the chunk since it was last simulated
+    int dirty;
+    // Tick the chunk was last simulated in
+    uint64_t lastActive;
+    // Cells that moved while the chunk was last simulated, a swap moves two
+    int moved;
+    // One bit per cell that was already updated during the current tick
+    uint64_t updated[CHUNK_SIZE];
+    // One bit per row that changed since the renderer last drew the chunk
+    uint64_t dirtyRows;
+    // Bitplanes mirroring the cells, bit x of a row word is set when cell x of that row is occupied, has
+    // gravity or holds the given material. The material plane of EMPTY stays zero.
+    uint64_t occupied[CHUNK_SIZE];
+    uint64_t gravity[CHUNK_SIZE];
+    uint64_t material[BLOCK_TYPE_COUNT][CHUNK_SIZE];
+    uint8_t type[CHUNK_CELLS];
+    uint8_t flags[CHUNK_CELLS];
+} Chunk;
+
+// A paged out chunk, its cells are run-length encoded or stored as is when that would be smaller
+typedef struct ColdChunk_
+{
+    uint8_t *data;   // the encoded cells, NULL when they are in the page file
+    uint32_t size;   // encoded size, 0 when the chunk is not paged out
+} ColdChunk;
+
+// Counters of the whole world, kept up to date as cells change so reading them never scans the cells
+typedef struct WorldStats_
+{
+    uint64_t tick;
+    // Cells holding each material, EMPTY counts the empty ones
+    uint64_t cells[BLOCK_TYPE_COUNT];
+    uint64_t blocks;
+    // Chunks in memory and paged out
+    int chunks;
+    int coldChunks;
+    // Chunks simulated in the last tick and the blocks in them
+    int awakeChunks;
+    uint64_t activeBlocks;
+    // Cells that moved in the last tick
+    uint64_t moved;
+    // Ticks in a row in which nothing moved
+    uint64_t quietTicks;
+    int settled;
+} WorldStats;
+
+typedef struct ChunkStats_
+{
+    int cells[BLOCK_TYPE_COUNT];
+    int blocks;
+    // Cells that moved in the last tick, 0 when the chunk was not simulated in it
+    int moved;
+    int awake;
+    int cold;
+} ChunkStats;
 
 typedef struct World_
 {
     int width;
     int height;
-    int simWidth;
-    int simHeight;
-    BlockEntry *blockHeader;
-    BlockEntry *blockTrailer;
-    BlockEntry **blockLocations;
+    int chunksX;
+    int chunksY;
+    Chunk **chunks;
+    Pool *chunkPool;
+    pthread_mutex_t chunkLock;
+    // Shade 0 of a material is its own color, the others are added as blocks of other colors get placed
+    Color shades[BLOCK_TYPE_COUNT][MATERIAL_SHADES];
+    int shadeCount[BLOCK_TYPE_COUNT];
+    uint64_t tick;
+    int phase;
+    int sleepChunks;
+    Engine engine;
+    // Cells a liquid flows sideways per tick, from 1 up to MAX_DISPERSION
+    int dispersion;
+    // Cells a block may fall per tick, from 1 up to MAX_FALL_SPEED. Falling blocks speed up by a cell
+    // per tick until they reach it.
+    int fallSpeed;
+    int awakeChunks;
+    int redrawAll;
+    uint64_t seed;
+    Rng rng;
+    ThreadPool *workers;
+    // Borrowed like workers, NULL when nothing is being timed
+    Profiler *profiler;
+    int *schedule;
+    // Set for chunks that were released before the renderer drew their last changes
+    uint8_t *clearedChunks;
+    // Occupied cells of every column within each chunk row, at chunkY * width + x. Kept outside of the
+    // chunks so it stays right while they are paged out.
+    uint8_t *columnCounts;
+    // Cells of every material in each chunk, BLOCK_TYPE_COUNT entries per chunk. Like the column counts
+    // they stay with the world while a chunk is paged out. The entry of EMPTY is not used.
+    uint16_t *materialCounts;
+    uint64_t movedCells;
+    uint64_t activeBlocks;
+    uint64_t quietTicks;
+    // Paging, cold is NULL until setChunkPaging is called
+    ColdChunk *cold;
+    int coldChunks;
+    size_t coldBytes;
+    int pageAfter;
+    int pageFile;
 } World;
 
-BlockEntry *getBlockEntry(World *w, int x, int y);
+Chunk *pageInChunk(World *w, int index);
+
+static inline int getChunkIndex(World *w, int x, int y)
+{
+    return (y >> CHUNK_SHIFT) * w->chunksX + (x >> CHUNK_SHIFT);
+}
+
+// NULL when the tile is empty. Chunks may get allocated by another worker while the world is being
+// simulated, so the pointer is loaded with acquire semantics. A paged out chunk is brought back in.
+static inline Chunk *getChunk(World *w, int x, int y)
+{
+    int i = getChunkIndex(w, x, y);
+    Chunk *c = __atomic_load_n(&w->chunks[i], __ATOMIC_ACQUIRE);
+    if (c == NULL && w->cold != NULL) c = pageInChunk(w, i);
+    return c;
+}
+
+// Like getChunk for readers that do not change the cells. A paged out chunk stays out, its cells are
+// decoded into scratch, which is what gets returned then.
+const Chunk *peekChunk(World *w, int x, int y, Chunk *scratch);
+
+static inline int getCellIndex(int x, int y)
+{
+    return ((y & CHUNK_MASK) << CHUNK_SHIFT) | (x & CHUNK_MASK);
+}
+
+static inline int isInWorld(World *w, int x, int y)
+{
+    return x >= 0 && x < w->width && y >= 0 && y < w->height;
+}
+
+// Cells left, right and below the world read as concrete walls, cells above it read as empty
+static inline BlockType getBlockType(World *w, int x, int y)
+{
+    if (y >= w->height) return EMPTY;
+    if (x < 0 || x >= w->width || y < 0) return CONCRETE;
+    Chunk *c = getChunk(w, x, y);
+    if (c == NULL) return EMPTY;
+    return c->type[getCellIndex(x, y)];
+}
+
+Chunk *ensureChunk(World *w, int x, int y);
+
+void wakeChunksAround(World *w, int x, int y);
+
+void cellChanged(World *w, int x, int y);
 
-void setBlockEntry(World *w, int x, int y, BlockEntry *entry);
+// Set when nothing changed in the last tick and nothing woke a chunk since, ticking on would do nothing
+int isWorldSettled(World *w);
+
+// Changes the fall speed. Blocks falling at that moment lose their speed and start over from a cell per
+// tick, so none keeps a speed the new setting would not have given it.
+void setFallSpeed(World *w, int speed);
+
+void getWorldStats(World *w, WorldStats *s);
+
+// Counters of the chunk at cx, cy in chunk coordinates
+void getChunkStats(World *w, int cx, int cy, ChunkStats *s);
+
+// The shade of material t closest to c, added when there is room. Goes into the flags of a cell
+// shifted by SHADE_SHIFT.
+uint8_t getShade(World *w, BlockType t, Color c);
+
+// Entry of the frame palette that shows a cell
+static inline int getPaletteIndex(uint8_t type, uint8_t flags)
+{
+    return type * MATERIAL_SHADES + (flags >> SHADE_SHIFT);
+}
 
-void getBlock(World *w, int x, int y, Block **b);
+// Occupied cells of column x
+int getColumnCount(World *w, int x);
 
-void addBlock(World *w, Block **b, BlockType t, int x, int y);
+// Row of the topmost occupied cell of column x, -1 when the column is empty
+int getColumnTop(World *w, int x);
 
-void moveBlock(World *w, Block *b, int x, int y);
+// Lowest empty row of column x, the height of the world when the column is full
+int getColumnFree(World *w, int x);
 
-void swapBlockLocations(World *w, Block *b1, Block *b2);
+void getBlock(World *w, int x, int y, Block *b);
 
-void deleteBlock(World *w, Block *b);
+void addBlock(World *w, BlockType t, int x, int y, int gravity, Color c);
+
+void moveBlock(World *w, int x, int y, int nx, int ny);
+
+void swapBlockLocations(World *w, int x1, int y1, int x2, int y2);
+
+void deleteBlock(World *w, int x, int y);
+
+void fillRow(World *w, int x, int y, int count, uint8_t type, uint8_t flags);
+
+void writeRow(World *w, int x, int y, int count, const uint8_t *type, const uint8_t *flags, int skipEmpty);
 
 void createWorld(World **w, int width, int height);
 
+// Like createWorld, but returns 0 instead of exiting when the world does not fit in memory
+int tryCreateWorld(World **w, int width, int height);
+
+void seedWorld(World *w, uint64_t seed);
+
 void resetWorld(World *w);
 
+// Pages sleeping chunks out once they were idle for afterTicks, to the file at path or compressed in
+// memory when path is NULL. The file is removed right away and only lives as long as the world.
+// Call before the world is simulated. Returns 0 when the file can not be created.
+int setChunkPaging(World *w, int afterTicks, char *path);
+
+// Frees empty chunks and pages out cold ones, called between ticks
+void releaseIdleChunks(World *w);
+
+void getWorldAllocStats(World *w, PoolStats *s);
+
+// Bytes held by the world: chunk slabs, paged out chunks kept in memory and the chunk tables
+size_t getWorldMemory(World *w);
+
 void destroyWorld(World *w);
 
 #define PIXSIM_WORLD_H